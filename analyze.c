@@ -0,0 +1,437 @@
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "walk.h"
+#include "symtab.h"
+#include "analyze.h"
+
+#include <limits.h>
+
+/* the state of one analysis */
+typedef struct
+{
+    CMinusParser *ps;
+    SymTab tab;
+    TreeNode *func; /* the FuncK being analyzed, or NULL */
+    int globals;    /* words of global memory given out */
+    int frame;      /* words of func's frame in use */
+    int errors;
+    int failed; /* memory is exhausted */
+} Analyzer;
+
+static const char *const typeName[] = {"void", "int", "int[]"};
+
+/* semanticError starts an error message in the
+   listing, for the caller to finish */
+static void semanticError(Analyzer *a, int lineno)
+{
+    outStr(&a->ps->out, "\n2019141460148王世杰\n>>> Semantic error at line ");
+    outInt(&a->ps->out, lineno, 0);
+    outStr(&a->ps->out, ": ");
+    a->errors++;
+}
+
+static int isStmt(const TreeNode *t, StmtKind kind)
+{
+    return t != NULL && t->nodekind == StmtK && t->kind.stmt == kind;
+}
+
+static int isExp(const TreeNode *t, ExpKind kind)
+{
+    return t != NULL && t->nodekind == ExpK && t->kind.exp == kind;
+}
+
+/* declName returns the IdK naming what a Var_DeclK,
+   ParamK or FuncK declares, or NULL */
+static TreeNode *declName(TreeNode *t)
+{
+    TreeNode *id = t->child[1];
+    if (isExp(id, Arry_DeclK))
+        id = id->child[0];
+    return isExp(id, IdK) && id->attr.name != NULL ? id : NULL;
+}
+
+/* declType returns the type a Var_DeclK, ParamK or
+   FuncK declares */
+static ExpType declType(const TreeNode *t)
+{
+    if (!isExp(t->child[0], IntK))
+        return Void;
+    if (isExp(t->child[1], Arry_DeclK) || (isStmt(t, ParamK) && t->child[2] != NULL))
+        return IntArray;
+    return Integer;
+}
+
+/* declare enters the name t declares in the current
+   scope */
+static void declare(Analyzer *a, TreeNode *t)
+{
+    TreeNode *id = declName(t);
+    Symbol *s;
+    if (id == NULL)
+        return;
+    s = declareSymbol(&a->tab, id->attr.name, t);
+    if (s == NULL)
+        a->failed = TRUE;
+    else if (s->decl != t)
+    {
+        semanticError(a, id->lineno);
+        if (s->decl->lineno > 0)
+            outPrintf(&a->ps->out, "%s already declared at line %d\n", id->attr.name, s->decl->lineno);
+        else
+            outPrintf(&a->ps->out, "%s already declared as a built-in function\n", id->attr.name);
+    }
+}
+
+/* place gives the variable t declares a slot after
+   those in use, in global memory or in the frame */
+static void place(Analyzer *a, TreeNode *t)
+{
+    TreeNode *id = declName(t), *len;
+    int size = 1;
+    int *used = a->func != NULL ? &a->frame : &a->globals;
+    if (t->type == IntArray && isStmt(t, ParamK))
+        size = 2; /* the address and length of the array */
+    else if (t->type == IntArray)
+    {
+        len = t->child[1]->child[1];
+        size = len != NULL ? len->attr.val : 0;
+        if (size <= 0 && id != NULL)
+        {
+            semanticError(a, id->lineno);
+            outPrintf(&a->ps->out, "array %s has no elements\n", id->attr.name);
+        }
+    }
+    if (size <= 0 || size > INT_MAX / 2 - *used)
+    {
+        if (size > 0 && id != NULL)
+        {
+            semanticError(a, id->lineno);
+            outPrintf(&a->ps->out, "%s does not fit in memory\n", id->attr.name);
+        }
+        size = 1;
+    }
+    t->slot = a->func != NULL ? *used : GLOBAL_SLOT(*used);
+    *used += size;
+    if (a->func != NULL && a->frame > a->func->slot)
+        a->func->slot = a->frame;
+}
+
+/* builtin returns a FuncK declaring a built-in
+   function of type type, taking one int or nothing */
+static TreeNode *builtin(CMinusParser *ps, ExpKind type, const char *name, int takesInt)
+{
+    TreeNode *f = newStmtNodeWith(ps, FuncK), *params = newStmtNodeWith(ps, ParamsK), *p;
+    if (f == NULL || params == NULL)
+        return NULL;
+    f->lineno = 0;
+    f->type = type == IntK ? Integer : Void;
+    f->slot = takesInt;
+    f->child[0] = newExpNodeWith(ps, type);
+    f->child[1] = newExpNodeWith(ps, IdK);
+    if (f->child[1] != NULL)
+        f->child[1]->attr.name = (char *)internNameWith(ps, name, strlen(name));
+    f->child[2] = params;
+    if (!takesInt)
+        params->child[0] = newExpNodeWith(ps, VoidK);
+    else if ((p = newStmtNodeWith(ps, ParamK)) != NULL)
+    {
+        p->child[0] = newExpNodeWith(ps, IntK);
+        p->child[1] = newExpNodeWith(ps, IdK);
+        if (p->child[1] != NULL)
+            p->child[1]->attr.name = (char *)internNameWith(ps, "x", 1);
+        p->type = Integer;
+        params->child[0] = p;
+    }
+    return f;
+}
+
+/* isDeclName tells whether the IdK at pos names what
+   its parent declares, rather than using a name */
+static int isDeclName(const WalkPos *pos)
+{
+    const TreeNode *p = pos->parent;
+    return isStmt(p, Var_DeclK) || isStmt(p, ParamK) || isStmt(p, FuncK) || isExp(p, Arry_DeclK);
+}
+
+/* isBody tells whether the CompK at pos is a function
+   body, which shares the function's scope */
+static int isBody(const WalkPos *pos)
+{
+    return isStmt(pos->parent, FuncK);
+}
+
+/* enter declares names and opens scopes on the way
+   down, and resolves each use of a name */
+static int enter(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Analyzer *a = arg;
+    TreeNode *id;
+    Symbol *s;
+    if (isStmt(t, Var_DeclK) || isStmt(t, ParamK))
+    {
+        t->type = declType(t);
+        if (t->type == Void && (id = declName(t)) != NULL)
+        {
+            semanticError(a, id->lineno);
+            outPrintf(&a->ps->out, "%s %s declared void\n", isStmt(t, ParamK) ? "parameter" : "variable",
+                      id->attr.name);
+        }
+        declare(a, t);
+        place(a, t);
+    }
+    else if (isStmt(t, FuncK))
+    {
+        t->type = declType(t);
+        declare(a, t);
+        a->func = t;
+        a->frame = t->slot = 0;
+        a->failed = a->failed || !pushScope(&a->tab);
+    }
+    else if (isStmt(t, CompK))
+    {
+        t->slot = a->frame;
+        if (!isBody(pos))
+            a->failed = a->failed || !pushScope(&a->tab);
+    }
+    else if (isExp(t, IdK) && !isDeclName(pos) && t->attr.name != NULL)
+    {
+        s = lookupSymbol(&a->tab, t->attr.name);
+        t->decl = s != NULL ? s->decl : NULL;
+        if (s == NULL)
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "undeclared name %s\n", t->attr.name);
+        }
+    }
+    return a->failed ? WALK_STOP : WALK_CONTINUE;
+}
+
+/* isInt tells whether t is missing, as after a
+   reported error, or of type int */
+static int isInt(const TreeNode *t)
+{
+    return t == NULL || t->type == Integer;
+}
+
+static int listLength(const TreeNode *t)
+{
+    int n = 0;
+    for (; t != NULL; t = t->sibling)
+        n++;
+    return n;
+}
+
+/* checkArgs matches the arguments of a call to f
+   with its parameters, in number and type */
+static void checkArgs(Analyzer *a, TreeNode *call, TreeNode *f)
+{
+    TreeNode *args = call->child[1] != NULL ? call->child[1]->child[0] : NULL;
+    TreeNode *params = f->child[2] != NULL ? f->child[2]->child[0] : NULL;
+    TreeNode *arg, *param;
+    const char *name = call->child[0]->attr.name;
+    int n = 1;
+    if (isExp(params, VoidK))
+        params = NULL;
+    if (listLength(args) != listLength(params))
+    {
+        semanticError(a, call->lineno);
+        outPrintf(&a->ps->out, "%s called with %d arguments, expected %d\n", name, listLength(args),
+                  listLength(params));
+        return;
+    }
+    for (arg = args, param = params; arg != NULL; arg = arg->sibling, param = param->sibling, n++)
+        if (arg->type != param->type)
+        {
+            semanticError(a, arg->lineno);
+            outPrintf(&a->ps->out, "argument %d of %s is %s, expected %s\n", n, name, typeName[arg->type],
+                      typeName[param->type]);
+        }
+}
+
+/* checkExp gives an expression its type, from those
+   of its children, and checks them */
+static void checkExp(Analyzer *a, TreeNode *t, const WalkPos *pos)
+{
+    TreeNode *id = t->child[0];
+    int i;
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        t->type = Integer;
+        break;
+    case IdK:
+        if (isDeclName(pos))
+            break;
+        t->type = t->decl != NULL ? t->decl->type : Integer;
+        if (isStmt(t->decl, FuncK) && !(isExp(pos->parent, CallK) && pos->slot == 0))
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "function %s used as a variable\n", t->attr.name);
+            t->type = Integer;
+        }
+        break;
+    case Arry_ElemK:
+        t->type = Integer;
+        if (id == NULL)
+            break;
+        t->decl = id->decl;
+        if (id->decl != NULL && !isStmt(id->decl, FuncK) && id->type != IntArray)
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "%s is not an array\n", id->attr.name);
+        }
+        if (!isInt(t->child[1]))
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "index of %s is %s, not int\n", id->attr.name, typeName[t->child[1]->type]);
+        }
+        break;
+    case CallK:
+        t->type = Integer;
+        if (id == NULL || (t->decl = id->decl) == NULL)
+            break;
+        if (!isStmt(t->decl, FuncK))
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "%s is not a function\n", id->attr.name);
+            break;
+        }
+        t->type = t->decl->type;
+        checkArgs(a, t, t->decl);
+        break;
+    case OpK:
+        t->type = Integer;
+        for (i = 0; i < 2; i++)
+            if (!isInt(t->child[i]))
+            {
+                semanticError(a, t->lineno);
+                outPrintf(&a->ps->out, "%s operand of ", typeName[t->child[i]->type]);
+                printTokenWith(a->ps, t->attr.op, NULL);
+            }
+        break;
+    default:
+        break;
+    }
+}
+
+/* checkStmt checks the types a statement needs: int
+   conditions, assigned values and returned values */
+static void checkStmt(Analyzer *a, TreeNode *t)
+{
+    TreeNode *e = t->child[0];
+    switch (t->kind.stmt)
+    {
+    case IfK:
+    case WhileK:
+        if (!isInt(e))
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "%s condition is %s, not int\n", isStmt(t, IfK) ? "if" : "while",
+                      typeName[e->type]);
+        }
+        break;
+    case AssignK:
+        t->type = Integer; /* an assignment in an expression has the value assigned */
+        if (isExp(e, IdK) && e->type == IntArray)
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "cannot assign to array %s\n", e->attr.name);
+        }
+        if (!isInt(t->child[1]))
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "assigned value is %s, not int\n", typeName[t->child[1]->type]);
+        }
+        break;
+    case ReturnK:
+        if (a->func == NULL)
+            break;
+        if (a->func->type == Void && e != NULL)
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "void function %s returns a value\n", a->func->child[1]->attr.name);
+        }
+        else if (a->func->type == Integer && e == NULL)
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "int function %s returns no value\n", a->func->child[1]->attr.name);
+        }
+        else if (a->func->type == Integer && !isInt(e))
+        {
+            semanticError(a, t->lineno);
+            outPrintf(&a->ps->out, "return value is %s, not int\n", typeName[e->type]);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* leave closes scopes and types expressions on the
+   way up: the children of a node are done before it */
+static int leave(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Analyzer *a = arg;
+    if (isStmt(t, FuncK))
+    {
+        popScope(&a->tab);
+        a->func = NULL;
+    }
+    else if (isStmt(t, CompK))
+    {
+        /* the next block reuses the frame of this one */
+        a->frame = t->slot;
+        if (!isBody(pos))
+            popScope(&a->tab);
+    }
+    else if (t->nodekind == ExpK)
+        checkExp(a, t, pos);
+    else
+        checkStmt(a, t);
+    return WALK_CONTINUE;
+}
+
+/* Function analyzeWith resolves every name used in a
+ * syntax tree the parser built to its declaration and
+ * returns the number of semantic errors
+ */
+int analyzeWith(CMinusParser *ps, TreeNode *tree)
+{
+    Analyzer a;
+    ParseStats *stats = ps->stats;
+    TreeNode *input, *output;
+    ps->stats = NULL; /* the built-ins are not parsed */
+    input = builtin(ps, IntK, "input", FALSE);
+    output = builtin(ps, VoidK, "output", TRUE);
+    ps->stats = stats;
+    a.ps = ps;
+    a.func = NULL;
+    a.globals = a.frame = 0;
+    a.errors = 0;
+    a.failed = input == NULL || output == NULL;
+    initSymTab(&a.tab);
+    if (!a.failed)
+    {
+        declare(&a, input);
+        declare(&a, output);
+    }
+    if (!a.failed && walkTree(tree, enter, leave, &a) < 0)
+        a.failed = TRUE;
+    if (a.failed)
+    {
+        outStr(&ps->out, "Out of memory error analyzing tree\n");
+        a.errors++;
+    }
+    freeSymTab(&a.tab);
+    outFlush(&ps->out);
+    return a.errors;
+}
+
+/* Function analyze resolves the names of a syntax
+ * tree built by parse, reporting to the listing file
+ */
+int analyze(TreeNode *tree)
+{
+    return analyzeWith(defaultParser(), tree);
+}
@@ -0,0 +1,46 @@
+#ifndef _ANALYZE_H_
+#define _ANALYZE_H_
+
+/* Function analyzeWith resolves every name used in a
+ * syntax tree the parser built to its declaration and
+ * checks its types, in one walk over the tree, and
+ * returns the number of semantic errors, which go to
+ * the parser's listing. Every IdK, CallK and
+ * Arry_ElemK use gets its decl set, NULL when
+ * undeclared; every expression gets its type, and
+ * every declaration the type it declares.
+ *
+ * Names must be declared once in a scope before they
+ * are used. The types are void, int and int[]: only
+ * arrays are indexed, with an int; only functions are
+ * called, with as many arguments as they have params,
+ * each of the param's type; operands, conditions of if
+ * and while, and assigned values are int, and arrays
+ * are not assigned to; an int function returns an int
+ * and a void function returns no value; variables and
+ * params are not void. Undeclared names are taken as
+ * int, so one mistake is reported once.
+ *
+ * The walk also lays out memory: every variable gets
+ * its slot, globals one after another from address 0
+ * and locals in their function's frame after its
+ * params, with the blocks that follow each other in a
+ * body sharing words. An int takes one word, an array
+ * its length, and an array param two, for the address
+ * and length of the array passed.
+ *
+ * Scopes are the globals, each function (its params
+ * and the outermost block of its body), and every
+ * compound statement nested in a body. A name is in
+ * scope from its declaration on, so a function can
+ * call itself. The built-in functions int input(void)
+ * and void output(int x) are globals.
+ */
+int analyzeWith(CMinusParser *, TreeNode *);
+
+/* Function analyze resolves the names of a syntax
+ * tree built by parse, reporting to the listing file
+ */
+int analyze(TreeNode *);
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+
+#include "arena.h"
+
+/* chunks start small and double up to MAXCHUNK, so
+   small inputs stay cheap and large ones make few
+   calls to malloc */
+#define MINCHUNK (16 * 1024)
+#define MAXCHUNK (1024 * 1024)
+#define ALIGNMENT 8
+
+/* Function arenaAlloc returns n bytes of memory
+ * aligned for any syntax tree data, or NULL if
+ * memory is exhausted
+ */
+void *arenaAlloc(Arena *arena, size_t n)
+{
+    ArenaChunk *chunk = arena->head;
+    void *p;
+    n = (n + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+    if (chunk == NULL || chunk->size - chunk->used < n)
+    {
+        size_t size = chunk == NULL ? MINCHUNK : chunk->size * 2;
+        if (size > MAXCHUNK)
+            size = MAXCHUNK;
+        if (size < n)
+            size = n;
+        chunk = malloc(sizeof(ArenaChunk) + size);
+        if (chunk == NULL)
+            return NULL;
+        chunk->size = size;
+        chunk->used = 0;
+        /* an oversized block gets a chunk of its own
+           behind the one being filled */
+        if (arena->head != NULL && size == n && n > MAXCHUNK)
+        {
+            chunk->next = arena->head->next;
+            arena->head->next = chunk;
+        }
+        else
+        {
+            chunk->next = arena->head;
+            arena->head = chunk;
+        }
+    }
+    p = chunk->data + chunk->used;
+    chunk->used += n;
+    arena->allocated += n;
+    return p;
+}
+
+/* Procedure adoptArena moves every block of src into
+ * dst, so that they are released with dst; src is
+ * left empty
+ */
+void adoptArena(Arena *dst, Arena *src)
+{
+    ArenaChunk *tail = src->head;
+    if (tail == NULL)
+        return;
+    while (tail->next != NULL)
+        tail = tail->next;
+    /* keep filling dst's current chunk */
+    if (dst->head == NULL)
+        dst->head = src->head;
+    else
+    {
+        tail->next = dst->head->next;
+        dst->head->next = src->head;
+    }
+    dst->allocated += src->allocated;
+    src->head = NULL;
+    src->allocated = 0;
+}
+
+/* Procedure freeArena releases every block allocated
+ * from the arena and leaves it empty
+ */
+void freeArena(Arena *arena)
+{
+    ArenaChunk *chunk = arena->head;
+    while (chunk != NULL)
+    {
+        ArenaChunk *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->head = NULL;
+    arena->allocated = 0;
+}
@@ -0,0 +1,42 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+/* An Arena is a bump allocator: memory is carved out
+ * of large chunks and released all at once by
+ * freeArena. A zero-initialized Arena is empty and
+ * ready to use.
+ */
+typedef struct arenaChunk
+{
+    struct arenaChunk *next;
+    size_t size; /* usable bytes in data */
+    size_t used; /* bytes handed out so far */
+    char data[];
+} ArenaChunk;
+
+typedef struct
+{
+    ArenaChunk *head;  /* chunk currently being filled */
+    size_t allocated;  /* total bytes handed out */
+} Arena;
+
+/* Function arenaAlloc returns n bytes of memory
+ * aligned for any syntax tree data, or NULL if
+ * memory is exhausted
+ */
+void *arenaAlloc(Arena *, size_t n);
+
+/* Procedure adoptArena moves every block of src into
+ * dst, so that they are released with dst; src is
+ * left empty
+ */
+void adoptArena(Arena *dst, Arena *src);
+
+/* Procedure freeArena releases every block allocated
+ * from the arena and leaves it empty
+ */
+void freeArena(Arena *);
+
+#endif
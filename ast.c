@@ -0,0 +1,235 @@
+#include "globals.h"
+#include "util.h"
+#include "ast.h"
+#include "walk.h"
+
+/* growable arrays being filled by toCompactAst; the
+   name map sends an interned name pointer to its
+   index in names[], and open[d] is the index of the
+   last node added at depth d */
+typedef struct
+{
+    CompactAst *ast;
+    unsigned nodeCap, lineCap, kidCap, nameCap;
+    const char **nameKeys;
+    AstIndex *nameIndex;
+    unsigned mapCap;
+    AstIndex *open;
+    unsigned openCap;
+    int failed;
+} Builder;
+
+/* grow makes room for one more element in an array
+   of count elements of size bytes, doubling it */
+static int grow(void **array, unsigned count, unsigned *cap, size_t size)
+{
+    void *p;
+    unsigned n;
+    if (count < *cap)
+        return TRUE;
+    n = *cap ? *cap * 2 : 256;
+    p = realloc(*array, n * size);
+    if (p == NULL)
+        return FALSE;
+    *array = p;
+    *cap = n;
+    return TRUE;
+}
+
+/* nameIndexOf returns the names[] index of an interned
+   name, adding it the first time it is seen; a missing
+   name maps to AST_NIL */
+static AstIndex nameIndexOf(Builder *b, const char *name)
+{
+    CompactAst *ast = b->ast;
+    unsigned h, i;
+    if (name == NULL)
+        return AST_NIL;
+    if (2 * (ast->nameCount + 1) > b->mapCap)
+    {
+        unsigned cap = b->mapCap ? b->mapCap * 2 : 256;
+        const char **keys = calloc(cap, sizeof(*keys));
+        AstIndex *index = malloc(cap * sizeof(*index));
+        if (keys == NULL || index == NULL)
+        {
+            free(keys);
+            free(index);
+            b->failed = TRUE;
+            return AST_NIL;
+        }
+        for (i = 0; i < b->mapCap; i++)
+            if (b->nameKeys[i] != NULL)
+            {
+                for (h = ((size_t)b->nameKeys[i] >> 3) & (cap - 1); keys[h] != NULL; h = (h + 1) & (cap - 1))
+                    ;
+                keys[h] = b->nameKeys[i];
+                index[h] = b->nameIndex[i];
+            }
+        free(b->nameKeys);
+        free(b->nameIndex);
+        b->nameKeys = keys;
+        b->nameIndex = index;
+        b->mapCap = cap;
+    }
+    for (h = ((size_t)name >> 3) & (b->mapCap - 1); b->nameKeys[h] != NULL; h = (h + 1) & (b->mapCap - 1))
+        if (b->nameKeys[h] == name)
+            return b->nameIndex[h];
+    if (!grow((void **)&ast->names, ast->nameCount, &b->nameCap, sizeof(*ast->names)))
+    {
+        b->failed = TRUE;
+        return AST_NIL;
+    }
+    ast->names[ast->nameCount] = name;
+    b->nameKeys[h] = name;
+    b->nameIndex[h] = ast->nameCount;
+    return ast->nameCount++;
+}
+
+/* addNode appends node t, visited in pre-order, and
+   links it to its parent or previous sibling */
+static int addNode(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Builder *b = arg;
+    CompactAst *ast = b->ast;
+    AstIndex idx = ast->nodeCount, kids;
+    unsigned depth = pos->depth;
+    int i, nkids = MAXCHILDREN;
+    AstNode *n;
+    if (!grow((void **)&ast->nodes, ast->nodeCount, &b->nodeCap, sizeof(AstNode)) ||
+        !grow((void **)&ast->lines, ast->nodeCount, &b->lineCap, sizeof(int)) ||
+        !grow((void **)&b->open, depth, &b->openCap, sizeof(AstIndex)))
+    {
+        b->failed = TRUE;
+        return WALK_STOP;
+    }
+    ast->nodeCount++;
+    while (nkids > 0 && t->child[nkids - 1] == NULL)
+        nkids--;
+    kids = ast->kidCount;
+    for (i = 0; i < nkids; i++)
+    {
+        if (!grow((void **)&ast->kids, ast->kidCount, &b->kidCap, sizeof(AstIndex)))
+        {
+            b->failed = TRUE;
+            return WALK_STOP;
+        }
+        ast->kids[ast->kidCount++] = AST_NIL;
+    }
+    n = &ast->nodes[idx];
+    n->tag = t->nodekind == StmtK ? AST_TAG(StmtK, t->kind.stmt) : AST_TAG(ExpK, t->kind.exp);
+    n->nkids = nkids;
+    n->reserved = 0;
+    n->kids = kids;
+    n->sibling = AST_NIL;
+    n->attr = 0;
+    if (t->nodekind == ExpK && t->kind.exp == IdK)
+        n->attr = nameIndexOf(b, t->attr.name);
+    else if (t->nodekind == ExpK && t->kind.exp == ConstK)
+        n->attr = t->attr.val;
+    else if (t->nodekind == ExpK && t->kind.exp == OpK)
+        n->attr = t->attr.op;
+    ast->lines[idx] = t->lineno;
+    /* the nodes added since open[depth] was the previous
+       sibling all lie below it, as do those since
+       open[depth - 1] was the parent */
+    if (pos->prev != NULL)
+        ast->nodes[b->open[depth]].sibling = idx;
+    else if (depth > 0)
+        ast->kids[ast->nodes[b->open[depth - 1]].kids + pos->slot] = idx;
+    else
+        ast->root = idx;
+    b->open[depth] = idx;
+    return b->failed ? WALK_STOP : WALK_CONTINUE;
+}
+
+/* Function toCompactAst copies the syntax tree into
+ * a new CompactAst; NULL if memory is exhausted
+ */
+CompactAst *toCompactAst(TreeNode *tree)
+{
+    Builder b;
+    CompactAst *ast = calloc(1, sizeof(CompactAst));
+    if (ast == NULL)
+        return NULL;
+    memset(&b, 0, sizeof(b));
+    b.ast = ast;
+    ast->root = AST_NIL;
+    if (walkTree(tree, addNode, NULL, &b) < 0)
+        b.failed = TRUE;
+    free(b.nameKeys);
+    free(b.nameIndex);
+    free(b.open);
+    if (b.failed)
+    {
+        freeCompactAst(ast);
+        return NULL;
+    }
+    return ast;
+}
+
+/* Function fromCompactAst rebuilds a TreeNode tree
+ * from a CompactAst, e.g. for printTree
+ */
+TreeNode *fromCompactAst(const CompactAst *ast)
+{
+    TreeNode **made, *tree;
+    AstIndex i;
+    int k;
+    if (ast->root == AST_NIL)
+        return NULL;
+    made = malloc(ast->nodeCount * sizeof(TreeNode *));
+    if (made == NULL)
+        return NULL;
+    /* children and siblings come after a node in
+       pre-order, so going backwards they are built
+       before the node that links to them */
+    for (i = ast->nodeCount; i-- > 0;)
+    {
+        const AstNode *n = &ast->nodes[i];
+        int kind = AST_KIND(n->tag);
+        TreeNode *t = AST_NODEKIND(n->tag) == StmtK ? newStmtNode(kind) : newExpNode(kind);
+        if (t == NULL)
+        {
+            free(made);
+            return NULL;
+        }
+        t->lineno = ast->lines[i];
+        if (AST_NODEKIND(n->tag) == ExpK && kind == IdK)
+            t->attr.name = n->attr == (int)AST_NIL ? NULL : (char *)ast->names[n->attr];
+        else if (AST_NODEKIND(n->tag) == ExpK && kind == ConstK)
+            t->attr.val = n->attr;
+        else if (AST_NODEKIND(n->tag) == ExpK && kind == OpK)
+            t->attr.op = n->attr;
+        for (k = 0; k < n->nkids; k++)
+            if (ast->kids[n->kids + k] != AST_NIL)
+                t->child[k] = made[ast->kids[n->kids + k]];
+        if (n->sibling != AST_NIL)
+            t->sibling = made[n->sibling];
+        made[i] = t;
+    }
+    tree = made[ast->root];
+    free(made);
+    return tree;
+}
+
+/* Function compactAstBytes returns the memory used
+ * by the arrays of a CompactAst
+ */
+size_t compactAstBytes(const CompactAst *ast)
+{
+    return ast->nodeCount * (sizeof(AstNode) + sizeof(int)) +
+           ast->kidCount * sizeof(AstIndex) +
+           ast->nameCount * sizeof(const char *);
+}
+
+/* Procedure freeCompactAst releases a CompactAst */
+void freeCompactAst(CompactAst *ast)
+{
+    if (ast == NULL)
+        return;
+    free(ast->nodes);
+    free(ast->lines);
+    free(ast->kids);
+    free(ast->names);
+    free(ast);
+}
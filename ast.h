@@ -0,0 +1,66 @@
+#ifndef _AST_H_
+#define _AST_H_
+
+/* A CompactAst stores a whole syntax tree in a few
+ * contiguous arrays instead of one heap block per
+ * TreeNode. Nodes are laid out in pre-order (a node,
+ * its subtrees, then its next sibling) and refer to
+ * each other by 32-bit index, so tree walks move
+ * forward through memory. Child slots live out of
+ * line in kids[], holding only as many slots as the
+ * node uses; line numbers are kept in their own
+ * array, as are the distinct names of IdK nodes.
+ */
+
+typedef unsigned AstIndex;
+
+/* AST_NIL marks an empty child slot or no sibling */
+#define AST_NIL 0xFFFFFFFFu
+
+/* a tag packs the NodeKind above the StmtKind or
+   ExpKind of a node */
+#define AST_TAG(nodekind, kind) ((unsigned char)((nodekind) << 4 | (kind)))
+#define AST_NODEKIND(tag) ((NodeKind)((tag) >> 4))
+#define AST_KIND(tag) ((tag) & 0x0F)
+
+typedef struct
+{
+    unsigned char tag;
+    unsigned char nkids; /* child slots used, at most MAXCHILDREN */
+    unsigned short reserved;
+    int attr;       /* op of OpK, val of ConstK, names[] index of IdK */
+    AstIndex kids;  /* first child slot in kids[] */
+    AstIndex sibling;
+} AstNode;
+
+typedef struct
+{
+    AstNode *nodes;
+    int *lines; /* lines[i] is the lineno of nodes[i] */
+    unsigned nodeCount;
+    AstIndex *kids;
+    unsigned kidCount;
+    const char **names;
+    unsigned nameCount;
+    AstIndex root;
+} CompactAst;
+
+/* Function toCompactAst copies the syntax tree into
+ * a new CompactAst; NULL if memory is exhausted
+ */
+CompactAst *toCompactAst(TreeNode *);
+
+/* Function fromCompactAst rebuilds a TreeNode tree
+ * from a CompactAst, e.g. for printTree
+ */
+TreeNode *fromCompactAst(const CompactAst *);
+
+/* Function compactAstBytes returns the memory used
+ * by the arrays of a CompactAst
+ */
+size_t compactAstBytes(const CompactAst *);
+
+/* Procedure freeCompactAst releases a CompactAst */
+void freeCompactAst(CompactAst *);
+
+#endif
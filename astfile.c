@@ -0,0 +1,287 @@
+#include "globals.h"
+#include "util.h"
+#include "astfile.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* sections start on 8-byte boundaries */
+#define ALIGN8(n) (((n) + 7) & ~(size_t)7)
+
+/* writeSection writes n bytes at p followed by the
+   padding up to the next section */
+static int writeSection(FILE *f, const void *p, size_t n)
+{
+    static const char zeros[8];
+    if (n > 0 && fwrite(p, 1, n, f) != n)
+        return -1;
+    if (ALIGN8(n) > n && fwrite(zeros, 1, ALIGN8(n) - n, f) != ALIGN8(n) - n)
+        return -1;
+    return 0;
+}
+
+/* Function writeAstFileTo writes the CompactAst as
+ * an AST file at the current position of f; returns
+ * 0, or -1 on a write error
+ */
+int writeAstFileTo(const CompactAst *ast, FILE *f)
+{
+    AstFileHeader h;
+    unsigned *offsets;
+    size_t text = 0, pos;
+    unsigned i;
+    int rc = 0;
+
+    offsets = malloc((ast->nameCount + 1) * sizeof(unsigned));
+    if (offsets == NULL)
+        return -1;
+    for (i = 0; i < ast->nameCount; i++)
+    {
+        offsets[i] = text;
+        text += strlen(ast->names[i]) + 1;
+    }
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, AST_FILE_MAGIC, sizeof(h.magic));
+    h.version = AST_FILE_VERSION;
+    h.byteOrder = AST_FILE_BYTEORDER;
+    h.nodeCount = ast->nodeCount;
+    h.kidCount = ast->kidCount;
+    h.nameCount = ast->nameCount;
+    h.root = ast->root;
+    pos = ALIGN8(sizeof(h));
+    h.nodesOffset = pos;
+    pos += ALIGN8(ast->nodeCount * sizeof(AstNode));
+    h.linesOffset = pos;
+    pos += ALIGN8(ast->nodeCount * sizeof(int));
+    h.kidsOffset = pos;
+    pos += ALIGN8(ast->kidCount * sizeof(AstIndex));
+    h.nameOffsetsOffset = pos;
+    pos += ALIGN8(ast->nameCount * sizeof(unsigned));
+    h.textOffset = pos;
+    h.textSize = text;
+    if (pos + text > 0xFFFFFFFFu)
+    {
+        free(offsets);
+        return -1;
+    }
+
+    if (writeSection(f, &h, sizeof(h)) < 0 ||
+        writeSection(f, ast->nodes, ast->nodeCount * sizeof(AstNode)) < 0 ||
+        writeSection(f, ast->lines, ast->nodeCount * sizeof(int)) < 0 ||
+        writeSection(f, ast->kids, ast->kidCount * sizeof(AstIndex)) < 0 ||
+        writeSection(f, offsets, ast->nameCount * sizeof(unsigned)) < 0)
+        rc = -1;
+    for (i = 0; rc == 0 && i < ast->nameCount; i++)
+        if (fwrite(ast->names[i], 1, strlen(ast->names[i]) + 1, f) != strlen(ast->names[i]) + 1)
+            rc = -1;
+    free(offsets);
+    return rc;
+}
+
+/* Function writeAstFile writes the CompactAst to the
+ * file named path; returns 0, or -1 on a write error
+ */
+int writeAstFile(const CompactAst *ast, const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    int rc;
+    if (f == NULL)
+        return -1;
+    rc = writeAstFileTo(ast, f);
+    if (fclose(f) != 0)
+        rc = -1;
+    return rc;
+}
+
+/* sectionOk checks that count elements of size bytes
+   at offset lie inside a file of size bytes */
+static int sectionOk(size_t fileSize, unsigned offset, unsigned count, size_t size)
+{
+    return offset % 8 == 0 && offset <= fileSize &&
+           (fileSize - offset) / size >= count;
+}
+
+/* refOk checks a child or sibling reference of node
+   i: nodes are in pre-order, so every reference points
+   further on, and no node may be reached twice */
+static int refOk(const AstFile *a, AstIndex i, AstIndex ref, unsigned char *seen)
+{
+    if (ref == AST_NIL)
+        return TRUE;
+    if (ref <= i || ref >= a->nodeCount || seen[ref])
+        return FALSE;
+    seen[ref] = TRUE;
+    return TRUE;
+}
+
+/* checkAstFile makes sure that walking the tree can
+   neither leave the file nor loop, so the loaded
+   arrays can be used without further checks */
+static int checkAstFile(const AstFile *a)
+{
+    unsigned char *seen;
+    unsigned i;
+    int k, ok = TRUE;
+    if (a->nodeCount == 0 ? a->root != AST_NIL : a->root != 0)
+        return FALSE;
+    /* the text ends in a NUL, so every name in it does */
+    for (i = 0; i < a->nameCount; i++)
+        if (a->nameOffsets[i] >= a->textSize)
+            return FALSE;
+    seen = calloc(a->nodeCount ? a->nodeCount : 1, 1);
+    if (seen == NULL)
+        return FALSE;
+    for (i = 0; ok && i < a->nodeCount; i++)
+    {
+        const AstNode *n = &a->nodes[i];
+        int kind = AST_KIND(n->tag);
+        if (AST_NODEKIND(n->tag) == StmtK)
+            ok = kind <= CompK;
+        else if (AST_NODEKIND(n->tag) == ExpK)
+            ok = kind <= ArgsK &&
+                 (kind != IdK || n->attr == (int)AST_NIL || (unsigned)n->attr < a->nameCount);
+        else
+            ok = FALSE;
+        ok = ok && n->nkids <= MAXCHILDREN &&
+             n->kids <= a->kidCount && a->kidCount - n->kids >= n->nkids;
+        for (k = 0; ok && k < n->nkids; k++)
+            ok = refOk(a, i, a->kids[n->kids + k], seen);
+        ok = ok && refOk(a, i, n->sibling, seen);
+    }
+    free(seen);
+    return ok;
+}
+
+/* Function openAstFile maps and checks the AST file
+ * named path; NULL if it cannot be read or is not a
+ * well-formed AST file of this version
+ */
+AstFile *openAstFile(const char *path)
+{
+    AstFile *a;
+    const AstFileHeader *h;
+    struct stat st;
+    void *map;
+    size_t size;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(AstFileHeader))
+    {
+        close(fd);
+        return NULL;
+    }
+    size = st.st_size;
+    map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    h = map;
+    a = calloc(1, sizeof(AstFile));
+    if (a == NULL ||
+        memcmp(h->magic, AST_FILE_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != AST_FILE_VERSION || h->byteOrder != AST_FILE_BYTEORDER ||
+        !sectionOk(size, h->nodesOffset, h->nodeCount, sizeof(AstNode)) ||
+        !sectionOk(size, h->linesOffset, h->nodeCount, sizeof(int)) ||
+        !sectionOk(size, h->kidsOffset, h->kidCount, sizeof(AstIndex)) ||
+        !sectionOk(size, h->nameOffsetsOffset, h->nameCount, sizeof(unsigned)) ||
+        !sectionOk(size, h->textOffset, h->textSize, 1) ||
+        (h->textSize > 0 && ((const char *)map)[h->textOffset + h->textSize - 1] != '\0') ||
+        (h->nameCount > 0 && h->textSize == 0))
+    {
+        free(a);
+        munmap(map, size);
+        return NULL;
+    }
+    a->nodes = (const AstNode *)((const char *)map + h->nodesOffset);
+    a->lines = (const int *)((const char *)map + h->linesOffset);
+    a->nodeCount = h->nodeCount;
+    a->kids = (const AstIndex *)((const char *)map + h->kidsOffset);
+    a->kidCount = h->kidCount;
+    a->nameOffsets = (const unsigned *)((const char *)map + h->nameOffsetsOffset);
+    a->text = (const char *)map + h->textOffset;
+    a->textSize = h->textSize;
+    a->nameCount = h->nameCount;
+    a->root = h->root;
+    a->map = map;
+    a->mapSize = size;
+    if (!checkAstFile(a))
+    {
+        closeAstFile(a);
+        return NULL;
+    }
+    return a;
+}
+
+/* Function astFileName returns name i of a loaded
+ * AST file, or NULL for AST_NIL
+ */
+const char *astFileName(const AstFile *a, AstIndex i)
+{
+    if (i == AST_NIL)
+        return NULL;
+    return a->text + a->nameOffsets[i];
+}
+
+/* Function fromAstFile rebuilds a TreeNode tree in
+ * the parser's arena from a loaded AST file; names
+ * are interned in the parser's table
+ */
+TreeNode *fromAstFile(CMinusParser *ps, const AstFile *a)
+{
+    TreeNode **made, *tree;
+    AstIndex i;
+    int k;
+    if (a->root == AST_NIL)
+        return NULL;
+    made = malloc(a->nodeCount * sizeof(TreeNode *));
+    if (made == NULL)
+        return NULL;
+    /* checkAstFile made sure references only point
+       further on, so going backwards children and
+       siblings are built before the node that links to
+       them */
+    for (i = a->nodeCount; i-- > 0;)
+    {
+        const AstNode *n = &a->nodes[i];
+        int kind = AST_KIND(n->tag);
+        TreeNode *t = AST_NODEKIND(n->tag) == StmtK ? newStmtNodeWith(ps, kind) : newExpNodeWith(ps, kind);
+        if (t == NULL)
+        {
+            free(made);
+            return NULL;
+        }
+        t->lineno = a->lines[i];
+        if (AST_NODEKIND(n->tag) == ExpK && kind == IdK)
+        {
+            const char *name = astFileName(a, n->attr);
+            if (name != NULL)
+                t->attr.name = (char *)internNameWith(ps, name, strlen(name));
+        }
+        else if (AST_NODEKIND(n->tag) == ExpK && kind == ConstK)
+            t->attr.val = n->attr;
+        else if (AST_NODEKIND(n->tag) == ExpK && kind == OpK)
+            t->attr.op = n->attr;
+        for (k = 0; k < n->nkids; k++)
+            if (a->kids[n->kids + k] != AST_NIL)
+                t->child[k] = made[a->kids[n->kids + k]];
+        if (n->sibling != AST_NIL)
+            t->sibling = made[n->sibling];
+        made[i] = t;
+    }
+    tree = made[a->root];
+    free(made);
+    return tree;
+}
+
+/* Procedure closeAstFile unmaps a loaded AST file */
+void closeAstFile(AstFile *a)
+{
+    if (a == NULL)
+        return;
+    munmap(a->map, a->mapSize);
+    free(a);
+}
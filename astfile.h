@@ -0,0 +1,94 @@
+#ifndef _ASTFILE_H_
+#define _ASTFILE_H_
+
+#include "ast.h"
+
+/* An AST file holds a CompactAst on disk so a tree
+ * can be loaded by mapping the file, with no parsing
+ * or copying. After the header come, each aligned to
+ * 8 bytes:
+ *
+ *   nodes[nodeCount]        the AstNode table
+ *   lines[nodeCount]        int line of each node
+ *   kids[kidCount]          AstIndex child slots
+ *   nameOffsets[nameCount]  offset of each name in text
+ *   text[textSize]          the names, NUL-terminated
+ *
+ * Offsets are from the start of the file. Files are
+ * written in the host's byte order; a loader on a host
+ * of the other order rejects them.
+ */
+
+#define AST_FILE_MAGIC "CMAST\r\n\032"
+#define AST_FILE_VERSION 1
+#define AST_FILE_BYTEORDER 0x01020304u
+
+typedef struct
+{
+    char magic[8];      /* AST_FILE_MAGIC */
+    unsigned version;   /* AST_FILE_VERSION */
+    unsigned byteOrder; /* AST_FILE_BYTEORDER as written */
+    unsigned nodeCount;
+    unsigned kidCount;
+    unsigned nameCount;
+    AstIndex root;
+    unsigned nodesOffset;
+    unsigned linesOffset;
+    unsigned kidsOffset;
+    unsigned nameOffsetsOffset;
+    unsigned textOffset;
+    unsigned textSize;
+} AstFileHeader;
+
+/* An AstFile is a loaded AST file; its arrays point
+ * straight into the mapped file
+ */
+typedef struct
+{
+    const AstNode *nodes;
+    const int *lines;
+    unsigned nodeCount;
+    const AstIndex *kids;
+    unsigned kidCount;
+    const unsigned *nameOffsets;
+    const char *text;
+    unsigned textSize;
+    unsigned nameCount;
+    AstIndex root;
+
+    void *map; /* the mapped file */
+    size_t mapSize;
+} AstFile;
+
+/* Function writeAstFile writes the CompactAst to the
+ * file named path; returns 0, or -1 on a write error
+ */
+int writeAstFile(const CompactAst *, const char *path);
+
+/* Function writeAstFileTo writes the CompactAst as
+ * an AST file at the current position of f; returns
+ * 0, or -1 on a write error
+ */
+int writeAstFileTo(const CompactAst *, FILE *f);
+
+/* Function openAstFile maps and checks the AST file
+ * named path; NULL if it cannot be read or is not a
+ * well-formed AST file of this version
+ */
+AstFile *openAstFile(const char *path);
+
+/* Function astFileName returns name i of a loaded
+ * AST file, or NULL for AST_NIL
+ */
+const char *astFileName(const AstFile *, AstIndex i);
+
+/* Function fromAstFile rebuilds a TreeNode tree in
+ * the parser's arena from a loaded AST file; names
+ * are interned in the parser's table
+ */
+TreeNode *fromAstFile(CMinusParser *, const AstFile *);
+
+/* Procedure closeAstFile unmaps a loaded AST file */
+void closeAstFile(AstFile *);
+
+#endif
@@ -0,0 +1,416 @@
+#include "globals.h"
+#include "util.h"
+#include "parse.h"
+#include "scan.h"
+#include "ast.h"
+#include "cache.h"
+#include "analyze.h"
+#include "fold.h"
+#include "batch.h"
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+/* one input file and what became of it */
+typedef struct
+{
+    char *name;      /* as given on the command line */
+    double millis;   /* wall time spent on the file */
+    double scanMillis;  /* time of the scan pass when pretokenized */
+    double parseMillis; /* and of the parse pass */
+    int errors;      /* syntax errors, or -1 if not opened */
+    int semanticErrors; /* found by analyze once there are no syntax errors */
+} BatchJob;
+
+/* a file on its way through the parser */
+typedef struct
+{
+    BatchJob *job;
+    FILE *source, *listing;
+    char out[FILENAME_MAX]; /* listing file name */
+    CMinusParser ps;
+    CacheKey key;
+    size_t len;
+    TokenArray tokens;
+    int scanned; /* tokens holds the whole source */
+    double start;
+} OpenFile;
+
+/* Each worker owns a deque of job indices. It pops
+   work from the bottom of its own deque and, once
+   that is empty, steals from the top of the others',
+   so workers left with long files get help. All jobs
+   are dealt out up front; nothing is pushed later. */
+typedef struct
+{
+    pthread_mutex_t lock;
+    int *jobs;
+    int top;    /* next job a thief takes */
+    int bottom; /* one past the next job the owner takes */
+} WorkQueue;
+
+typedef struct
+{
+    BatchJob *jobs;
+    WorkQueue *queues;
+    int nworkers;
+    int pretokenize; /* scan each file ahead on a helper thread */
+    Cache *cache;    /* or NULL */
+} BatchPool;
+
+typedef struct
+{
+    BatchPool *pool;
+    int id;
+} Worker;
+
+static double nowMillis(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* popJob takes the next job from the bottom of q */
+static int popJob(WorkQueue *q)
+{
+    int job = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->top < q->bottom)
+        job = q->jobs[--q->bottom];
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+/* stealJob takes the oldest job from the top of q */
+static int stealJob(WorkQueue *q)
+{
+    int job = -1;
+    pthread_mutex_lock(&q->lock);
+    if (q->top < q->bottom)
+        job = q->jobs[q->top++];
+    pthread_mutex_unlock(&q->lock);
+    return job;
+}
+
+/* nextJob returns the worker's next job, stealing
+   when its own deque is empty; -1 when all are done */
+static int nextJob(Worker *w)
+{
+    BatchPool *pool = w->pool;
+    int i, job = popJob(&pool->queues[w->id]);
+    for (i = 1; job < 0 && i < pool->nworkers; i++)
+        job = stealJob(&pool->queues[(w->id + i) % pool->nworkers]);
+    return job;
+}
+
+/* openJob opens a file and its listing, using the
+   same file naming as single-file mode, and answers
+   it from the cache if possible; returns TRUE if the
+   file is left to be parsed */
+static int openJob(OpenFile *f, BatchJob *job, Cache *cache)
+{
+    char pgm[FILENAME_MAX];
+    const char *base = strrchr(job->name, '/');
+    char *dot;
+
+    f->job = job;
+    f->start = nowMillis();
+    f->key = 0;
+    f->len = 0;
+    f->scanned = FALSE;
+    snprintf(pgm, sizeof(pgm), "%s", job->name);
+    base = base ? base + 1 : job->name;
+    if (strchr(base, '.') == NULL)
+        strncat(pgm, ".c-", sizeof(pgm) - strlen(pgm) - 1);
+    snprintf(f->out, sizeof(f->out), "%s", job->name);
+    dot = strchr(f->out + (base - job->name), '.');
+    if (dot != NULL)
+        *dot = '\0';
+    strncat(f->out, ".txt", sizeof(f->out) - strlen(f->out) - 1);
+
+    job->errors = -1;
+    job->semanticErrors = 0;
+    f->source = fopen(pgm, "r");
+    if (f->source == NULL)
+        return FALSE;
+    f->listing = fopen(f->out, "w");
+    if (f->listing == NULL)
+    {
+        fclose(f->source);
+        return FALSE;
+    }
+    initParser(&f->ps, f->source, f->listing);
+    if (cache != NULL)
+    {
+        const char *text = sourceText(&f->ps, &f->len);
+        f->key = cacheKey(text, f->len);
+        if (cacheFetch(cache, f->key, f->len, f->listing, NULL, &job->errors, &job->semanticErrors))
+        {
+            closeParser(&f->ps);
+            fclose(f->source);
+            fclose(f->listing);
+            job->millis = nowMillis() - f->start;
+            return FALSE;
+        }
+    }
+    fprintf(f->listing, "CMINUS PARSING:\n");
+    return TRUE;
+}
+
+/* scanFile scans an open file into tokens; it runs
+   on a helper thread while the worker parses the
+   file before. If memory runs out, the scanner goes
+   back to the start for finishJob to parse it all */
+static void *scanFile(void *arg)
+{
+    OpenFile *f = arg;
+    double start = nowMillis();
+    size_t len;
+    f->scanned = tokenizeWith(&f->ps, &f->tokens) >= 0;
+    if (!f->scanned)
+        seekSource(&f->ps, sourceText(&f->ps, &len), 1);
+    f->job->scanMillis = nowMillis() - start;
+    return NULL;
+}
+
+/* finishJob parses an open file, from its tokens if
+   it was scanned ahead, writes out the listing and
+   closes it */
+static void finishJob(OpenFile *f, Cache *cache)
+{
+    BatchJob *job = f->job;
+    TreeNode *syntaxTree;
+    int folded;
+    double start = nowMillis();
+    syntaxTree = f->scanned ? parseTokensWith(&f->ps, &f->tokens) : parseWith(&f->ps);
+    job->parseMillis = nowMillis() - start;
+    if (TraceParse)
+    {
+        fprintf(f->listing, "\nSyntax tree:\n");
+        printTreeWith(&f->ps, syntaxTree);
+    }
+    if (f->ps.errorCount == 0)
+        job->semanticErrors = analyzeWith(&f->ps, syntaxTree);
+    if (f->ps.errorCount == 0 && job->semanticErrors == 0 && FoldConstants)
+    {
+        folded = foldTree(syntaxTree);
+        if (folded < 0)
+            fprintf(f->listing, "Out of memory error folding constants\n");
+        else
+            fprintf(f->listing, "\nConstant folding eliminated %d nodes\n", folded);
+        if (folded > 0 && TraceParse)
+        {
+            fprintf(f->listing, "\nFolded syntax tree:\n");
+            printTreeWith(&f->ps, syntaxTree);
+        }
+    }
+    job->errors = f->ps.errorCount;
+    fclose(f->listing);
+    if (cache != NULL)
+    {
+        CompactAst *ast = toCompactAst(syntaxTree);
+        cacheStore(cache, f->key, f->len, f->out, ast, job->errors, job->semanticErrors);
+        freeCompactAst(ast);
+    }
+    freeTokenArray(&f->tokens);
+    closeParser(&f->ps);
+    fclose(f->source);
+    job->millis = nowMillis() - f->start;
+}
+
+static void *workerMain(void *arg)
+{
+    Worker *w = arg;
+    OpenFile f;
+    int job;
+    memset(&f.tokens, 0, sizeof(f.tokens));
+    while ((job = nextJob(w)) >= 0)
+        if (openJob(&f, &w->pool->jobs[job], w->pool->cache))
+            finishJob(&f, w->pool->cache);
+    return NULL;
+}
+
+/* pipelineMain works through the jobs like workerMain
+   but in two passes per file: the next file is
+   scanned into tokens on a helper thread while the
+   worker parses the current one from its tokens */
+static void *pipelineMain(void *arg)
+{
+    Worker *w = arg;
+    BatchPool *pool = w->pool;
+    OpenFile files[2];
+    OpenFile *cur = NULL, *next;
+    pthread_t helper;
+    int job, slot = 0, helping;
+    memset(files, 0, sizeof(files));
+    do
+    {
+        next = NULL;
+        while (next == NULL && (job = nextJob(w)) >= 0)
+            if (openJob(&files[slot], &pool->jobs[job], pool->cache))
+            {
+                next = &files[slot];
+                slot ^= 1;
+            }
+        helping = next != NULL && pthread_create(&helper, NULL, scanFile, next) == 0;
+        if (cur != NULL)
+            finishJob(cur, pool->cache);
+        if (helping)
+            pthread_join(helper, NULL);
+        else if (next != NULL)
+            scanFile(next);
+        cur = next;
+    } while (cur != NULL);
+    return NULL;
+}
+
+/* readManifest collects file names, one per line,
+   from standard input */
+static char **readManifest(int *count)
+{
+    char line[FILENAME_MAX];
+    char **names = NULL;
+    int n = 0, cap = 0;
+    while (fgets(line, sizeof(line), stdin))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0')
+            continue;
+        if (n == cap)
+        {
+            char **grown = realloc(names, (cap = cap ? cap * 2 : 64) * sizeof(char *));
+            if (grown == NULL)
+                break;
+            names = grown;
+        }
+        names[n] = malloc(strlen(line) + 1);
+        if (names[n] == NULL)
+            break;
+        strcpy(names[n++], line);
+    }
+    *count = n;
+    return names;
+}
+
+/* Function runBatch parses every file in names (or,
+ * when count is 0, every file named on a line of
+ * standard input) on a pool of threads, one per core
+ * unless threads is positive, scanning each file
+ * ahead on a helper thread if pretokenize is set;
+ * unchanged files are answered from cache unless it
+ * is NULL
+ */
+int runBatch(char *names[], int count, int threads, int pretokenize, Cache *cache)
+{
+    char **manifest = NULL;
+    BatchPool pool;
+    pthread_t *tids;
+    Worker *workers;
+    double start, wall;
+    int i, started = 0, failed = 0, totalErrors = 0, totalSemantic = 0;
+
+    if (count == 0)
+        names = manifest = readManifest(&count);
+    if (count == 0)
+    {
+        fprintf(stderr, "no input files\n");
+        return 1;
+    }
+    pool.nworkers = threads > 0 ? threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (pool.nworkers < 1)
+        pool.nworkers = 1;
+    if (pool.nworkers > count)
+        pool.nworkers = count;
+    pool.cache = cache;
+    /* the scan pass would write echo and trace output
+       ahead of the parser's messages */
+    pool.pretokenize = pretokenize && !EchoSource && !TraceScan;
+    pool.jobs = calloc(count, sizeof(BatchJob));
+    pool.queues = calloc(pool.nworkers, sizeof(WorkQueue));
+    tids = calloc(pool.nworkers, sizeof(pthread_t));
+    workers = calloc(pool.nworkers, sizeof(Worker));
+    if (!pool.jobs || !pool.queues || !tids || !workers)
+    {
+        fprintf(stderr, "Out of memory error\n");
+        return 1;
+    }
+
+    /* deal contiguous runs of files to the workers */
+    for (i = 0; i < count; i++)
+        pool.jobs[i].name = names[i];
+    for (i = 0; i < pool.nworkers; i++)
+    {
+        int first = (int)((long)count * i / pool.nworkers);
+        int last = (int)((long)count * (i + 1) / pool.nworkers);
+        int j;
+        WorkQueue *q = &pool.queues[i];
+        pthread_mutex_init(&q->lock, NULL);
+        q->jobs = malloc((last - first) * sizeof(int));
+        /* the owner pops from the bottom, so store the
+           run reversed to parse it in order */
+        for (j = first; j < last; j++)
+            q->jobs[last - 1 - j] = j;
+        q->top = 0;
+        q->bottom = last - first;
+    }
+
+    start = nowMillis();
+    for (i = 0; i < pool.nworkers; i++)
+    {
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+    /* the calling thread is worker 0, and steals the
+       jobs of any worker whose thread fails to start */
+    for (i = 1; i < pool.nworkers; i++)
+        if (pthread_create(&tids[started], NULL, pool.pretokenize ? pipelineMain : workerMain, &workers[i]) == 0)
+            started++;
+    (pool.pretokenize ? pipelineMain : workerMain)(&workers[0]);
+    for (i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    wall = nowMillis() - start;
+
+    for (i = 0; i < count; i++)
+    {
+        BatchJob *job = &pool.jobs[i];
+        if (job->errors < 0)
+        {
+            printf("%10s  %s not found\n", "-", job->name);
+            failed++;
+        }
+        else
+        {
+            printf("%8.3f ms ", job->millis);
+            if (pool.pretokenize)
+                printf("(scan %8.3f, parse %8.3f) ", job->scanMillis, job->parseMillis);
+            printf("%4d error%s %4d semantic  %s\n", job->errors, job->errors == 1 ? " " : "s",
+                   job->semanticErrors, job->name);
+            totalErrors += job->errors;
+            totalSemantic += job->semanticErrors;
+            failed += job->errors > 0 || job->semanticErrors > 0;
+        }
+    }
+    printf("%d files, %d syntax errors, %d semantic errors, %d failed, %.3f ms on %d threads (%.1f files/s)\n",
+           count, totalErrors, totalSemantic, failed, wall, started + 1, count / (wall / 1e3));
+    if (cache != NULL)
+        printf("cache: %ld hits, %ld misses\n", cache->hits, cache->misses);
+
+    for (i = 0; i < pool.nworkers; i++)
+    {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+        free(pool.queues[i].jobs);
+    }
+    if (manifest != NULL)
+    {
+        for (i = 0; i < count; i++)
+            free(manifest[i]);
+        free(manifest);
+    }
+    free(pool.jobs);
+    free(pool.queues);
+    free(tids);
+    free(workers);
+    return failed;
+}
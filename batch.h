@@ -0,0 +1,22 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "cache.h"
+
+/* Function runBatch parses every file in names (or,
+ * when count is 0, every file named on a line of
+ * standard input) on a pool of threads, one per core
+ * unless threads is positive; unchanged files are
+ * answered from cache unless it is NULL.
+ * With pretokenize, each worker parses a file from
+ * its token array while a helper thread scans the
+ * next one (see tokenizeWith).
+ * Each file gets its own listing, named like the
+ * single-file mode does, and a summary of per-file
+ * times and syntax and semantic errors is printed to
+ * stdout. Returns the number of files that failed to
+ * open or had syntax or semantic errors.
+ */
+int runBatch(char *names[], int count, int threads, int pretokenize, Cache *cache);
+
+#endif
@@ -0,0 +1,67 @@
+/* cmgen: writes a synthetic C- program (see gen.h)
+ * to standard output or to the file named with -o,
+ * e.g. as input for cparser or scanbench.
+ */
+#include "gen.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(char *prog)
+{
+    fprintf(stderr, "usage: %s [-o <file>] [--size <bytes>] [--functions <n>] [--depth <n>]\n", prog);
+    fprintf(stderr, "       [--expr-len <n>] [--comments <percent>] [--idents <n>] [--calls <n>] [--seed <n>]\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    GenShape shape;
+    FILE *out = stdout;
+    char *text;
+    size_t len;
+    int i;
+    initShape(&shape);
+    for (i = 1; i < argc; i++)
+    {
+        if (i + 1 == argc)
+            usage(argv[0]);
+        if (strcmp(argv[i], "-o") == 0)
+        {
+            out = fopen(argv[++i], "w");
+            if (out == NULL)
+            {
+                perror(argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--size") == 0)
+            shape.size = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--functions") == 0)
+            shape.functions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0)
+            shape.depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--expr-len") == 0)
+            shape.exprLen = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--comments") == 0)
+            shape.comments = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--idents") == 0)
+            shape.idents = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--calls") == 0)
+            shape.calls = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            shape.seed = strtoul(argv[++i], NULL, 10);
+        else
+            usage(argv[0]);
+    }
+    text = genProgram(&shape, &len);
+    if (text == NULL)
+    {
+        fprintf(stderr, "Out of memory error\n");
+        return 1;
+    }
+    fwrite(text, 1, len, out);
+    free(text);
+    return fclose(out) != 0;
+}
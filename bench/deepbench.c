@@ -0,0 +1,193 @@
+/* deepbench: stress test of the iterative tree walk.
+ * Builds syntax trees nested a million levels deep,
+ * far past what a recursive walk could take on the
+ * default 8 MB stack: compound statements inside
+ * compound statements, an if chain down its then
+ * branches, and an expression of a million and one
+ * operands that the parser folds into a left-deep Op
+ * chain. Each tree is walked in pre- and post-order
+ * and copied to a CompactAst and back; node counts
+ * and depths are checked and the time per node is
+ * reported. The listing grows with the square of the
+ * depth, so printTree is run on a shallower if chain.
+ * All of it runs on a thread with a 256 KB stack.
+ */
+#include "globals.h"
+#include "scan.h"
+#include "util.h"
+#include "parse.h"
+#include "ast.h"
+#include "walk.h"
+
+#include <pthread.h>
+#include <time.h>
+
+/* globals normally allocated by main.c */
+int lineno = 0;
+FILE *source;
+FILE *listing;
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+
+#define DEPTH 1000000
+#define PRINT_DEPTH 20000
+#define STACK_BYTES (256 * 1024)
+
+/* what a walk saw */
+typedef struct
+{
+    long pre, post;
+    int maxDepth;
+} Count;
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int countPre(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Count *c = arg;
+    c->pre++;
+    if (pos->depth > c->maxDepth)
+        c->maxDepth = pos->depth;
+    return WALK_CONTINUE;
+}
+
+static int countPost(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Count *c = arg;
+    c->post++;
+    return WALK_CONTINUE;
+}
+
+/* nestedCompounds returns { { ... { 1 } ... } } with
+   depth braces */
+static TreeNode *nestedCompounds(CMinusParser *ps, int depth)
+{
+    TreeNode *t = newExpNodeWith(ps, ConstK), *c;
+    while (depth-- > 0)
+    {
+        c = newStmtNodeWith(ps, CompK);
+        c->child[0] = t;
+        t = c;
+    }
+    return t;
+}
+
+/* ifChain returns if (x) if (x) ... 1 with depth ifs */
+static TreeNode *ifChain(CMinusParser *ps, int depth)
+{
+    TreeNode *t = newExpNodeWith(ps, ConstK), *f;
+    while (depth-- > 0)
+    {
+        f = newStmtNodeWith(ps, IfK);
+        f->child[0] = newExpNodeWith(ps, IdK);
+        f->child[0]->attr.name = (char *)internNameWith(ps, "x", 1);
+        f->child[1] = t;
+        t = f;
+    }
+    return t;
+}
+
+/* parsedChain parses a function whose body assigns
+   the sum of depth + 1 ones */
+static TreeNode *parsedChain(CMinusParser *ps, int depth, char **text)
+{
+    static const char head[] = "void f(void) { x = 1", tail[] = "; }\n";
+    int len = strlen(head) + 2 * depth + strlen(tail), i;
+    char *p = *text = malloc(len + 1);
+    memcpy(p, head, strlen(head));
+    p += strlen(head);
+    for (i = 0; i < depth; i++, p += 2)
+        memcpy(p, "+1", 2);
+    strcpy(p, tail);
+    setSourceText(ps, *text, *text + len, *text + len, 1, FALSE);
+    return parseWith(ps);
+}
+
+/* check walks tree, copies it to a CompactAst and
+   back and walks the copy, reporting the times;
+   FALSE if a count is off */
+static int check(const char *what, TreeNode *tree, long nodes, int maxDepth)
+{
+    Count c = {0, 0, 0}, copied = {0, 0, 0};
+    CompactAst *ast;
+    TreeNode *back;
+    double start, walkTime, copyTime;
+    int r;
+
+    start = seconds();
+    r = walkTree(tree, countPre, countPost, &c);
+    walkTime = seconds() - start;
+
+    start = seconds();
+    ast = toCompactAst(tree);
+    back = ast != NULL ? fromCompactAst(ast) : NULL;
+    copyTime = seconds() - start;
+    if (back != NULL)
+        walkTree(back, countPre, countPost, &copied);
+
+    printf("%-10s %7ld nodes, depth %7d: walk %7.3f ms (%5.1f ns/node), compact+rebuild %8.3f ms\n",
+           what, c.pre, c.maxDepth, walkTime * 1e3, walkTime * 1e9 / c.pre, copyTime * 1e3);
+    if (ast != NULL)
+        freeCompactAst(ast);
+    freeTrees();
+    if (r != 0 || c.pre != nodes || c.post != nodes || c.maxDepth != maxDepth ||
+        copied.pre != nodes || copied.post != nodes || copied.maxDepth != maxDepth)
+    {
+        printf("%s: expected %ld nodes, depth %d; walked %ld/%ld, depth %d; copy %ld/%ld, depth %d\n",
+               what, nodes, maxDepth, c.pre, c.post, c.maxDepth,
+               copied.pre, copied.post, copied.maxDepth);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static void *stress(void *arg)
+{
+    CMinusParser ps;
+    TreeNode *tree;
+    char *text;
+    double start;
+    int ok = TRUE;
+
+    initParser(&ps, NULL, listing);
+    ok = check("compounds", nestedCompounds(&ps, DEPTH), DEPTH + 1L, DEPTH) && ok;
+    freeTreesWith(&ps);
+    ok = check("if chain", ifChain(&ps, DEPTH), 2L * DEPTH + 1, DEPTH) && ok;
+    freeTreesWith(&ps);
+    /* FuncK with its type, name and params, Compk,
+       Assign and its IdK, then the Op chain */
+    tree = parsedChain(&ps, DEPTH, &text);
+    ok = ps.errorCount == 0 && ok;
+    ok = check("expression", tree, 8 + 2L * DEPTH + 1, 3 + DEPTH) && ok;
+    free(text);
+    freeTreesWith(&ps);
+
+    tree = ifChain(&ps, PRINT_DEPTH);
+    start = seconds();
+    printTreeWith(&ps, tree);
+    printf("printTree  %7d nodes, depth %7d: %7.3f ms\n",
+           2 * PRINT_DEPTH + 1, PRINT_DEPTH, (seconds() - start) * 1e3);
+    closeParser(&ps);
+    return ok ? arg : NULL;
+}
+
+int main(void)
+{
+    pthread_attr_t attr;
+    pthread_t tid;
+    void *ok = NULL;
+    listing = fopen("/dev/null", "w");
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, STACK_BYTES);
+    if (pthread_create(&tid, &attr, stress, &attr) != 0)
+        return 1;
+    pthread_join(tid, &ok);
+    pthread_attr_destroy(&attr);
+    return ok != NULL ? 0 : 1;
+}
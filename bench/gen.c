@@ -0,0 +1,487 @@
+/* gen: deterministic generator of synthetic C-
+ * programs for the benchmarks (see gen.h).
+ */
+#include "gen.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* words comments are made of */
+static const char *const words[] = {
+    "find", "the", "position", "of", "smallest", "element", "between",
+    "low", "and", "high", "sort", "array", "in", "place", "return",
+    "sum", "each", "value", "until", "done", "next", "index",
+};
+
+#define WORDS (sizeof(words) / sizeof(words[0]))
+
+/* operators of expressions and conditions */
+static const char *const addops[] = {" + ", " - ", " * ", " / "};
+static const char *const relops[] = {" < ", " <= ", " > ", " >= ", " == ", " ~= "};
+
+/* a program being generated */
+typedef struct
+{
+    const GenShape *shape;
+    char *text;
+    size_t len, cap;
+    int failed;
+    unsigned long long rng;
+    int function; /* functions before this one may be called */
+    int parens;   /* parentheses open in the current expression */
+    int loops;    /* counted loops open, in a program that runs */
+} Gen;
+
+/* the size of the global array mem */
+#define MEMSIZE 1024
+
+/* chance in percent that a statement nests others,
+   below the deepest level */
+#define NEST_CHANCE 30
+
+static void put(Gen *g, const char *s, size_t n)
+{
+    if (g->failed)
+        return;
+    if (g->len + n + 1 > g->cap)
+    {
+        size_t cap = g->cap ? g->cap : 4096;
+        char *grown;
+        while (g->len + n + 1 > cap)
+            cap *= 2;
+        grown = realloc(g->text, cap);
+        if (grown == NULL)
+        {
+            g->failed = 1;
+            return;
+        }
+        g->text = grown;
+        g->cap = cap;
+    }
+    memcpy(g->text + g->len, s, n);
+    g->len += n;
+}
+
+static void putStr(Gen *g, const char *s)
+{
+    put(g, s, strlen(s));
+}
+
+static void putf(Gen *g, const char *fmt, ...)
+{
+    char buf[64];
+    va_list ap;
+    int n;
+    va_start(ap, fmt);
+    n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    put(g, buf, n);
+}
+
+/* below returns a pseudo-random number in [0, n),
+   from a xorshift64* generator */
+static int below(Gen *g, int n)
+{
+    g->rng ^= g->rng >> 12;
+    g->rng ^= g->rng << 25;
+    g->rng ^= g->rng >> 27;
+    return n > 0 ? (int)(((g->rng * 2685821657736338717ULL) >> 33) % n) : 0;
+}
+
+static void indent(Gen *g, int level)
+{
+    while (level-- > 0)
+        put(g, "\t", 1);
+}
+
+/* putName writes name i of a family: lead followed by
+   i in base 26 written with letters, since C- names
+   have no digits */
+static void putName(Gen *g, char lead, int i)
+{
+    char buf[16];
+    int n = 0;
+    buf[n++] = lead;
+    do
+    {
+        buf[n++] = 'a' + i % 26;
+        i /= 26;
+    } while (i > 0);
+    put(g, buf, n);
+}
+
+static void putVar(Gen *g)
+{
+    putName(g, 'x', below(g, g->shape->idents));
+}
+
+/* putIndex writes an index of mem */
+static void putIndex(Gen *g)
+{
+    if (g->shape->calls)
+        putf(g, "%d", below(g, MEMSIZE));
+    else
+        putVar(g);
+}
+
+static void putExp(Gen *g, int operands);
+
+/* putCall writes a call of one of the functions
+   before the current one; each takes two ints */
+static void putCall(Gen *g)
+{
+    putName(g, 'f', below(g, g->function));
+    putStr(g, "(");
+    putExp(g, 1);
+    putStr(g, ", ");
+    putExp(g, 1);
+    putStr(g, ")");
+}
+
+static void putOperand(Gen *g)
+{
+    int r = below(g, 100);
+    if (r < 5 && g->parens < 2 && g->shape->exprLen > 1)
+    {
+        g->parens++;
+        putStr(g, "(");
+        putExp(g, 2 + below(g, 3));
+        putStr(g, ")");
+        g->parens--;
+    }
+    else if (r < 10 && g->function > 0 && g->parens < 2 && !g->shape->calls)
+    {
+        g->parens++;
+        putCall(g);
+        g->parens--;
+    }
+    else if (r < 25)
+    {
+        putStr(g, "mem[");
+        putIndex(g);
+        putStr(g, "]");
+    }
+    else if (r < 55)
+        putf(g, "%d", below(g, 1000));
+    else
+        putVar(g);
+}
+
+/* putExp writes an expression of at most operands
+   operands */
+static void putExp(Gen *g, int operands)
+{
+    int n = 1 + below(g, operands), op;
+    putOperand(g);
+    while (--n > 0)
+    {
+        op = below(g, 4);
+        putStr(g, addops[op]);
+        if (op == 3 && g->shape->calls) /* never divide by zero */
+            putf(g, "%d", 1 + below(g, 9));
+        else
+            putOperand(g);
+    }
+}
+
+static void putCondition(Gen *g)
+{
+    putExp(g, g->shape->exprLen);
+    putStr(g, relops[below(g, 6)]);
+    putExp(g, g->shape->exprLen);
+}
+
+static void putComment(Gen *g, int level)
+{
+    int n = 2 + below(g, 10), i;
+    indent(g, level);
+    putStr(g, "/*");
+    for (i = 0; i < n; i++)
+    {
+        if (i > 0 && below(g, 8) == 0)
+        {
+            putStr(g, "\n");
+            indent(g, level);
+            putStr(g, "  ");
+        }
+        putStr(g, " ");
+        putStr(g, words[below(g, WORDS)]);
+    }
+    putStr(g, " */\n");
+}
+
+static void putStmt(Gen *g, int depth, int level);
+
+/* loopHead starts a counted loop, for a program that
+   runs, as one statement on a line already indented to
+   level; its body goes at level + 2. The counter is a
+   local of its own, and the loop goes around 3 times,
+   or once inside two others */
+static void loopHead(Gen *g, int level)
+{
+    putStr(g, "{\n");
+    indent(g, level + 1);
+    putName(g, 'k', g->loops);
+    putStr(g, " = 0;\n");
+    indent(g, level + 1);
+    putStr(g, "while (");
+    putName(g, 'k', g->loops);
+    putf(g, " < %d)\n", g->loops < 2 ? 3 : 1);
+    indent(g, level + 1);
+    putStr(g, "{\n");
+    g->loops++;
+}
+
+/* loopTail counts a turn and ends the loop */
+static void loopTail(Gen *g, int level)
+{
+    g->loops--;
+    indent(g, level + 2);
+    putName(g, 'k', g->loops);
+    putStr(g, " = ");
+    putName(g, 'k', g->loops);
+    putStr(g, " + 1;\n");
+    indent(g, level + 1);
+    putStr(g, "}\n");
+    indent(g, level);
+    putStr(g, "}\n");
+}
+
+/* putCompound writes { declarations statements } with
+   its braces on lines of their own */
+static void putCompound(Gen *g, int depth, int level, int stmts)
+{
+    indent(g, level);
+    putStr(g, "{\n");
+    if (below(g, 4) == 0)
+    {
+        indent(g, level + 1);
+        putStr(g, "int ");
+        putVar(g);
+        putStr(g, ";\n");
+    }
+    while (stmts-- > 0)
+        putStmt(g, depth, level + 1);
+    indent(g, level);
+    putStr(g, "}\n");
+}
+
+/* putStmt writes a statement nested depth levels deep
+   on its own lines */
+static void putStmt(Gen *g, int depth, int level)
+{
+    int r = below(g, 100);
+    if (below(g, 100) < g->shape->comments)
+        putComment(g, level);
+    if (depth < g->shape->depth && r < NEST_CHANCE)
+    {
+        r = below(g, 4);
+        if (r == 3)
+        {
+            putCompound(g, depth + 1, level, 1 + below(g, 3));
+            return;
+        }
+        indent(g, level);
+        if (r == 0 && g->shape->calls)
+        {
+            loopHead(g, level);
+            putStmt(g, depth + 1, level + 2);
+            loopTail(g, level);
+            return;
+        }
+        putStr(g, r == 0 ? "while (" : "if (");
+        putCondition(g);
+        putStr(g, ")\n");
+        putStmt(g, depth + 1, level + 1);
+        if (r == 2)
+        {
+            indent(g, level);
+            putStr(g, "else\n");
+            putStmt(g, depth + 1, level + 1);
+        }
+        return;
+    }
+    indent(g, level);
+    if (r < 50)
+        putVar(g);
+    else if (r < 65)
+    {
+        putStr(g, "mem[");
+        putIndex(g);
+        putStr(g, "]");
+    }
+    else if (g->function > 0 && r < 80)
+    {
+        if (g->shape->calls)
+        {
+            putf(g, "if (calls < %d)\n", g->shape->calls);
+            indent(g, level + 1);
+        }
+        putCall(g);
+        putStr(g, ";\n");
+        return;
+    }
+    else if (g->shape->calls && r >= 95)
+    {
+        putStr(g, "output(");
+        putExp(g, g->shape->exprLen);
+        putStr(g, ");\n");
+        return;
+    }
+    else
+        putVar(g);
+    putStr(g, " = ");
+    putExp(g, g->shape->exprLen);
+    putStr(g, ";\n");
+}
+
+/* putNest writes one statement nested as deep as the
+   shape allows, so that every program reaches it */
+static void putNest(Gen *g, int depth, int level)
+{
+    indent(g, level);
+    if (depth == g->shape->depth)
+    {
+        putVar(g);
+        putStr(g, " = 1;\n");
+        return;
+    }
+    switch (depth % 3)
+    {
+    case 0:
+        if (g->shape->calls)
+        {
+            loopHead(g, level);
+            putNest(g, depth + 1, level + 2);
+            loopTail(g, level);
+            return;
+        }
+        putStr(g, "while (");
+        break;
+    case 1:
+        putStr(g, "if (");
+        break;
+    default:
+        putStr(g, "{\n");
+        putNest(g, depth + 1, level + 1);
+        indent(g, level);
+        putStr(g, "}\n");
+        return;
+    }
+    putCondition(g);
+    putStr(g, ")\n");
+    putNest(g, depth + 1, level + 1);
+}
+
+/* putFunction writes function k, adding statements
+   until it is at least bytes long; its parameters
+   have names of their own so that its locals cannot
+   clash with them */
+static void putFunction(Gen *g, int k, size_t bytes)
+{
+    size_t start = g->len;
+    int i;
+    g->function = k;
+    putStr(g, "int ");
+    putName(g, 'f', k);
+    putStr(g, "(int pa, int pb)\n{\n\tint ");
+    putVar(g);
+    putStr(g, ";\n");
+    if (g->shape->calls)
+    {
+        /* loop counters, and the count of calls */
+        putStr(g, "\t");
+        for (i = 0; i <= g->shape->depth; i++)
+        {
+            putStr(g, "int ");
+            putName(g, 'k', i);
+            putStr(g, "; ");
+        }
+        putStr(g, "\n\tcalls = calls + 1;\n");
+    }
+    if (g->shape->depth > 0)
+        putNest(g, 0, 1);
+    do
+        putStmt(g, 0, 1);
+    while (!g->failed && g->len - start < bytes);
+    putStr(g, "\treturn ");
+    putExp(g, g->shape->exprLen);
+    putStr(g, ";\n}\n\n");
+}
+
+/* Procedure initShape fills a GenShape with the
+ * defaults
+ */
+void initShape(GenShape *shape)
+{
+    shape->size = GEN_SIZE;
+    shape->functions = GEN_FUNCTIONS;
+    shape->depth = GEN_DEPTH;
+    shape->exprLen = GEN_EXPRLEN;
+    shape->comments = GEN_COMMENTS;
+    shape->idents = GEN_IDENTS;
+    shape->calls = 0;
+    shape->seed = GEN_SEED;
+}
+
+/* Function genProgram returns a new NUL-terminated C-
+ * program of the given shape, storing its length in
+ * len; NULL if memory is exhausted
+ */
+char *genProgram(const GenShape *shape, size_t *len)
+{
+    GenShape s = *shape;
+    Gen g;
+    size_t bytes;
+    int i;
+    if (s.functions < 1)
+        s.functions = 1;
+    if (s.exprLen < 1)
+        s.exprLen = 1;
+    if (s.idents < 1)
+        s.idents = 1;
+    memset(&g, 0, sizeof(g));
+    g.shape = &s;
+    g.rng = 0x9E3779B97F4A7C15ULL ^ s.seed;
+    putf(&g, "/* generated: %d functions, depth %d, ", s.functions, s.depth);
+    putf(&g, "%d operands, %d%% comments, ", s.exprLen, s.comments);
+    putf(&g, "%d names, seed %lu */\n", s.idents, s.seed);
+    putf(&g, "int mem[%d];\n", MEMSIZE);
+    if (s.calls)
+        putStr(&g, "int calls;\n");
+    for (i = 0; i < s.idents; i++)
+    {
+        putStr(&g, "int ");
+        putName(&g, 'x', i);
+        putStr(&g, ";\n");
+    }
+    putStr(&g, "\n");
+    bytes = s.size > g.len ? (s.size - g.len) / s.functions : 0;
+    for (i = 0; i < s.functions && !g.failed; i++)
+        putFunction(&g, i, bytes);
+    g.function = s.functions;
+    putStr(&g, "void main(void)\n{\n\t");
+    if (s.calls)
+    {
+        putStr(&g, "output(");
+        putCall(&g);
+        putStr(&g, ");\n}\n");
+    }
+    else
+    {
+        putVar(&g);
+        putStr(&g, " = ");
+        putCall(&g);
+        putStr(&g, ";\n}\n");
+    }
+    if (g.failed)
+    {
+        free(g.text);
+        return NULL;
+    }
+    g.text[g.len] = '\0';
+    *len = g.len;
+    return g.text;
+}
@@ -0,0 +1,49 @@
+#ifndef _GEN_H_
+#define _GEN_H_
+
+#include <stddef.h>
+
+/* A GenShape describes a synthetic C- program for
+ * genProgram. The same shape and seed always give
+ * the same text, byte for byte.
+ */
+typedef struct
+{
+    size_t size;   /* bytes to aim for; 0 for one statement per function */
+    int functions; /* functions besides main */
+    int depth;     /* deepest nesting of if, while and { } */
+    int exprLen;   /* most operands in one expression */
+    int comments;  /* percent of statements with a comment */
+    int idents;    /* distinct variable names */
+    int calls;     /* 0 for a program only to be parsed (see below) */
+    unsigned long seed;
+} GenShape;
+
+/* defaults for the fields of a GenShape */
+#define GEN_SIZE (1L << 20)
+#define GEN_FUNCTIONS 100
+#define GEN_DEPTH 4
+#define GEN_EXPRLEN 6
+#define GEN_COMMENTS 10
+#define GEN_IDENTS 64
+#define GEN_SEED 1
+
+/* Procedure initShape fills a GenShape with the
+ * defaults above
+ */
+void initShape(GenShape *);
+
+/* Function genProgram returns a new NUL-terminated C-
+ * program of the given shape, storing its length in
+ * len; NULL if memory is exhausted. The program is
+ * also meaningful: every name is declared before it
+ * is used and every call passes as many arguments as
+ * the function takes. With calls set, it also runs to
+ * its end, writing what it computes with output:
+ * indexes and divisors are constants in range, loops
+ * count to 3 or 1, and no call is made once calls
+ * calls have been.
+ */
+char *genProgram(const GenShape *, size_t *len);
+
+#endif
@@ -0,0 +1,287 @@
+/* incrbench: incremental reparse benchmark.
+ * Builds a synthetic C- program of about 1 MB and
+ * simulates typing into the middle of it: each edit
+ * inserts one space in a function body and the next
+ * takes it out again. Reports the time per edit of
+ * parsing the whole text from scratch and of
+ * reparseWith reusing the previous tree. Then checks
+ * reparseWith against a full parse over a run of
+ * random edits to a smaller program, which add and
+ * remove blank space, lines, statements and whole
+ * functions. After each edit, the printed trees and
+ * the line of every node must be the same, or the
+ * run fails.
+ */
+#include "globals.h"
+#include "scan.h"
+#include "util.h"
+#include "parse.h"
+#include "incr.h"
+
+#include <time.h>
+#include <unistd.h>
+
+/* globals normally allocated by main.c */
+int lineno = 0;
+FILE *source;
+FILE *listing;
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+
+#define TARGET_BYTES (1L << 20)
+#define EDITS 200
+#define CHECK_BYTES (32L << 10)
+#define CHECK_EDITS 1000
+
+static const char *unit =
+    "/* find the position of the smallest element\n"
+    "   between low and high */\n"
+    "int minloc ( int a[], int low, int high )\n"
+    "{\tint i; int x; int k;\n"
+    "\tk = low;\n"
+    "\tx = a[low];\n"
+    "\ti = low + 1;\n"
+    "\twhile (i < high)\n"
+    "\t{\tif (a[i] < x)\n"
+    "\t\t{\tx = a[i];\n"
+    "\t\t\tk = i; }\n"
+    "\t\ti = i + 1;\n"
+    "\t}\n"
+    "\treturn k;\n"
+    "}\n\n";
+
+/* what the random edits insert */
+static const char *const blanks[] = {" ", "\t", "\n", "\n\n  "};
+static const char *statement = " k = k + 1;";
+static const char *function = "int f ( void )\n{ return 1; }\n";
+
+static unsigned long seed = 1;
+
+/* rnd returns a pseudo-random number below n */
+static int rnd(int n)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return (int)((seed >> 33) % (unsigned long)n);
+}
+
+static int isBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n';
+}
+
+/* findFrom returns the offset of the first s in text
+   at or after a random offset, wrapping around; -1 if
+   there is none */
+static int findFrom(const char *text, int len, const char *s)
+{
+    const char *hit = strstr(text + rnd(len), s);
+    if (hit == NULL)
+        hit = strstr(text, s);
+    return hit != NULL ? (int)(hit - text) : -1;
+}
+
+/* randomEdit fills in an edit of text that keeps it a
+   valid program; FALSE if the one it tried does not
+   apply */
+static int randomEdit(const char *text, int len, TextEdit *edit)
+{
+    int at;
+    edit->removed = 0;
+    edit->length = 0;
+    edit->text = "";
+    switch (rnd(6))
+    {
+    case 0: /* blank space next to blank space joins no tokens */
+    case 1:
+        at = rnd(len);
+        if (!isBlank(text[at]))
+            return FALSE;
+        edit->offset = at;
+        edit->text = blanks[rnd(4)];
+        edit->length = (int)strlen(edit->text);
+        return TRUE;
+    case 2:
+        at = rnd(len - 1);
+        if (!isBlank(text[at]) || !isBlank(text[at + 1]))
+            return FALSE;
+        edit->offset = at;
+        edit->removed = 1;
+        return TRUE;
+    case 3:
+        at = findFrom(text, len, "k = low;");
+        edit->offset = at + 8;
+        edit->text = statement;
+        edit->length = (int)strlen(statement);
+        return at >= 0;
+    case 4:
+        at = findFrom(text, len, statement);
+        edit->offset = at;
+        edit->removed = (int)strlen(statement);
+        return at >= 0;
+    default:
+        at = rnd(2) ? findFrom(text, len, "/* find") : findFrom(text, len, function);
+        edit->offset = at;
+        if (at >= 0 && strncmp(text + at, function, strlen(function)) == 0)
+            edit->removed = (int)strlen(function);
+        else
+        {
+            edit->text = function;
+            edit->length = (int)strlen(function);
+        }
+        return at >= 0;
+    }
+}
+
+/* sameLines tells whether trees a and b, printed the
+   same, also give every node the same line */
+static int sameLines(const TreeNode *a, const TreeNode *b)
+{
+    int i;
+    for (; a != NULL && b != NULL; a = a->sibling, b = b->sibling)
+    {
+        if (a->lineno != b->lineno)
+            return FALSE;
+        for (i = 0; i < MAXCHILDREN; i++)
+            if (!sameLines(a->child[i], b->child[i]))
+                return FALSE;
+    }
+    return a == b;
+}
+
+/* sameText tells whether files a and b hold the same
+   bytes, and empties both for the next edit */
+static int sameText(FILE *a, FILE *b)
+{
+    int x, y;
+    rewind(a);
+    rewind(b);
+    do
+    {
+        x = getc(a);
+        y = getc(b);
+    } while (x == y && x != EOF);
+    rewind(a);
+    rewind(b);
+    return x == y && ftruncate(fileno(a), 0) == 0 && ftruncate(fileno(b), 0) == 0;
+}
+
+/* checkEdits makes random edits to units copies of
+   the unit, reparsing after each; returns the number
+   of edits whose tree differed from a full parse */
+static int checkEdits(int units)
+{
+    CMinusParser full, inc;
+    TreeNode *tree, *expected;
+    TextEdit edit;
+    FILE *fullOut = tmpfile(), *incOut = tmpfile();
+    size_t unitLen = strlen(unit);
+    int len = units * unitLen, newLen, i, done = 0, bad = 0;
+    char *text = malloc(len + 1), *next;
+    if (text == NULL || fullOut == NULL || incOut == NULL)
+        return 1;
+    for (i = 0; i < units; i++)
+        memcpy(text + i * unitLen, unit, unitLen);
+    text[len] = '\0';
+    initParser(&full, NULL, fullOut);
+    initParser(&inc, NULL, incOut);
+    tree = reparseWith(&inc, NULL, NULL, NULL, text, len);
+    while (done < CHECK_EDITS)
+    {
+        if (!randomEdit(text, len, &edit))
+            continue;
+        next = applyEdit(text, len, &edit, &newLen);
+        if (next == NULL)
+            return 1;
+        tree = reparseWith(&inc, tree, text, &edit, next, newLen);
+        free(text);
+        text = next;
+        len = newLen;
+        done++;
+        freeTreesWith(&full);
+        setSourceText(&full, text, text + len, text + len, 1, FALSE);
+        expected = parseWith(&full);
+        printTreeWith(&full, expected);
+        printTreeWith(&inc, tree);
+        fflush(fullOut);
+        fflush(incOut);
+        if (!sameText(fullOut, incOut) || !sameLines(expected, tree) || full.errorCount > 0)
+        {
+            if (bad++ == 0)
+                fprintf(stderr, "edit %d (offset %d, -%d +%d) reparses differently\n", done, edit.offset,
+                        edit.removed, edit.length);
+        }
+    }
+    closeParser(&full);
+    closeParser(&inc);
+    fclose(fullOut);
+    fclose(incOut);
+    free(text);
+    return bad;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    CMinusParser full, inc;
+    TreeNode *tree;
+    TextEdit edit;
+    size_t unitLen = strlen(unit);
+    int units = TARGET_BYTES / unitLen, len = units * unitLen, newLen, i;
+    char *text = malloc(len + 1), *next;
+    double start, fullTime, incTime;
+    int bad;
+    listing = stdout;
+    for (i = 0; i < units; i++)
+        memcpy(text + i * unitLen, unit, unitLen);
+    text[len] = '\0';
+
+    /* the edit point: after "k = low;" in the middle unit */
+    edit.offset = (units / 2) * unitLen + (strstr(unit, "k = low;") - unit) + 8;
+    edit.removed = 0;
+    edit.text = " ";
+    edit.length = 1;
+
+    initParser(&full, NULL, listing);
+    start = seconds();
+    for (i = 0; i < EDITS; i++)
+    {
+        setSourceText(&full, text, text + len, text + len, 1, FALSE);
+        parseWith(&full);
+        freeTreesWith(&full);
+    }
+    fullTime = (seconds() - start) / EDITS;
+
+    initParser(&inc, NULL, listing);
+    tree = reparseWith(&inc, NULL, NULL, NULL, text, len);
+    start = seconds();
+    for (i = 0; i < EDITS; i++)
+    {
+        next = applyEdit(text, len, &edit, &newLen);
+        tree = reparseWith(&inc, tree, text, &edit, next, newLen);
+        free(text);
+        text = next;
+        len = newLen;
+        /* the next edit takes the space out again */
+        edit.removed = 1 - edit.removed;
+        edit.length = 1 - edit.length;
+    }
+    incTime = (seconds() - start) / EDITS;
+
+    printf("full parse: %8.3f ms/edit\n", fullTime * 1e3);
+    printf("reparse   : %8.3f ms/edit (%.0fx, %d bytes)\n",
+           incTime * 1e3, fullTime / incTime, len);
+    closeParser(&full);
+    closeParser(&inc);
+    free(text);
+
+    bad = checkEdits(CHECK_BYTES / unitLen);
+    printf("checked   : %d random edits, %d reparsed differently\n", CHECK_EDITS, bad);
+    return bad > 0;
+}
@@ -0,0 +1,101 @@
+/* kwbench: micro-benchmark for reserved word lookup.
+ * Classifies a fixed mix of identifiers and keywords
+ * with the old linear strcmp search and with the
+ * perfect-hash reservedLookup in scan.c, and reports
+ * identifiers per second for each.
+ */
+#include "globals.h"
+#include "scan.h"
+#include "util.h"
+
+#include <time.h>
+
+/* globals normally allocated by main.c */
+int lineno = 0;
+FILE *source;
+FILE *listing;
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+
+#define NIDS 4096
+#define ROUNDS 2000
+
+/* the lookup scan.c used before the perfect hash */
+static struct
+{
+    char *str;
+    TokenType tok;
+} linearWords[MAXRESERVED] = {{"if", IF}, {"else", ELSE}, {"int", INT}, {"return", RETURN}, {"void", VOID}, {"while", WHILE}};
+
+static TokenType linearLookup(const char *s, int len)
+{
+    int i;
+    (void)len;
+    for (i = 0; i < MAXRESERVED; i++)
+    {
+        if (!strcmp(s, linearWords[i].str))
+            return linearWords[i].tok;
+    }
+    return ID;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char ids[NIDS][MAXTOKENLEN + 1];
+static int lens[NIDS];
+
+static double run(TokenType (*lookup)(const char *, int), long *checksum)
+{
+    double start = seconds();
+    long sum = 0;
+    int r, i;
+    for (r = 0; r < ROUNDS; r++)
+        for (i = 0; i < NIDS; i++)
+            sum += lookup(ids[i], lens[i]);
+    *checksum = sum;
+    return seconds() - start;
+}
+
+int main(void)
+{
+    static const char *keywords[] = {"if", "else", "int", "return", "void", "while"};
+    unsigned seed = 12345;
+    long linearSum, hashSum;
+    double linearTime, hashTime, n = (double)NIDS * ROUNDS;
+    int i, j;
+    listing = stdout;
+    /* roughly one keyword in four, as in typical C- code */
+    for (i = 0; i < NIDS; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        if ((seed >> 16) % 4 == 0)
+            strcpy(ids[i], keywords[(seed >> 8) % 6]);
+        else
+        {
+            int len = 1 + (seed >> 20) % 10;
+            for (j = 0; j < len; j++)
+            {
+                seed = seed * 1103515245 + 12345;
+                ids[i][j] = 'a' + (seed >> 16) % 26;
+            }
+            ids[i][len] = '\0';
+        }
+        lens[i] = strlen(ids[i]);
+    }
+    linearTime = run(linearLookup, &linearSum);
+    hashTime = run(reservedLookup, &hashSum);
+    if (linearSum != hashSum)
+    {
+        fprintf(stderr, "kwbench: lookups disagree\n");
+        return 1;
+    }
+    printf("linear strcmp: %8.1f M ids/s\n", n / linearTime / 1e6);
+    printf("perfect hash : %8.1f M ids/s\n", n / hashTime / 1e6);
+    return 0;
+}
@@ -0,0 +1,227 @@
+/* parsebench: throughput of the scanner, the parser
+ * and the tree printer over synthetic programs (see
+ * gen.h) of several shapes: small flat functions,
+ * deep nesting, long expressions, heavy comments and
+ * many distinct names. Each shape is run in four
+ * modes, scanning only, parsing, parsing and printing
+ * the tree, and parsing and resolving its names (see
+ * analyze.h), from text in memory; after the
+ * warmup runs, the fastest and the median of the
+ * timed runs are reported with MB/s, tokens/s and
+ * the memory of the tree. With --budget, the run
+ * fails if parsing any shape is slower than the
+ * given MB/s.
+ */
+#include "globals.h"
+#include "scan.h"
+#include "util.h"
+#include "parse.h"
+#include "analyze.h"
+#include "gen.h"
+
+#include <sys/resource.h>
+#include <time.h>
+
+/* globals normally allocated by main.c */
+int lineno = 0;
+FILE *source;
+FILE *listing;
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+
+typedef struct
+{
+    const char *name;
+    int functions, depth, exprLen, comments, idents;
+} Shape;
+
+static const Shape shapes[] = {
+    {"default", GEN_FUNCTIONS, GEN_DEPTH, GEN_EXPRLEN, GEN_COMMENTS, GEN_IDENTS},
+    {"flat", 5000, 0, 3, 0, 16},
+    {"deep", 20, 200, 3, 5, GEN_IDENTS},
+    {"long-expr", GEN_FUNCTIONS, 2, 400, 0, GEN_IDENTS},
+    {"commented", GEN_FUNCTIONS, GEN_DEPTH, GEN_EXPRLEN, 90, GEN_IDENTS},
+    {"many-names", GEN_FUNCTIONS, GEN_DEPTH, GEN_EXPRLEN, GEN_COMMENTS, 50000},
+};
+
+#define SHAPES (sizeof(shapes) / sizeof(shapes[0]))
+
+typedef enum
+{
+    ScanMode,
+    ParseMode,
+    PrintMode,
+    AnalyzeMode,
+    MODES
+} Mode;
+
+static const char *const modeName[MODES] = {"scan", "parse", "print", "analyze"};
+
+/* what one run did */
+typedef struct
+{
+    long tokens;
+    size_t treeBytes;
+    int errors;
+    int semanticErrors;
+} Run;
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int byTime(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* runOnce runs mode over the len chars at text */
+static void runOnce(Mode mode, const char *text, size_t len, Run *run)
+{
+    CMinusParser ps;
+    TreeNode *tree;
+    initParser(&ps, NULL, listing);
+    setSourceText(&ps, text, text + len, text + len, 1, FALSE);
+    memset(run, 0, sizeof(*run));
+    if (mode == ScanMode)
+    {
+        while (getTokenWith(&ps) != ENDFILE)
+            run->tokens++;
+    }
+    else
+    {
+        tree = parseWith(&ps);
+        if (mode == PrintMode)
+            printTreeWith(&ps, tree);
+        if (mode == AnalyzeMode)
+            run->semanticErrors = analyzeWith(&ps, tree);
+        run->treeBytes = ps.arena.allocated;
+        run->errors = ps.errorCount;
+    }
+    closeParser(&ps);
+}
+
+static void usage(char *prog)
+{
+    size_t k;
+    fprintf(stderr, "usage: %s [--size <bytes>] [--repeat <n>] [--warmup <n>] [--seed <n>]\n", prog);
+    fprintf(stderr, "       [--shape <name>] [--mode scan|parse|print|analyze] [--budget <MB/s>]\n");
+    fprintf(stderr, "shapes:");
+    for (k = 0; k < SHAPES; k++)
+        fprintf(stderr, " %s", shapes[k].name);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    GenShape shape;
+    size_t size = 4L << 20, len, k;
+    int repeat = 5, warmup = 1, i, m, overBudget = 0;
+    unsigned long seed = GEN_SEED;
+    const char *only = NULL;
+    int onlyMode = -1;
+    double budget = 0;
+    struct rusage ru;
+    double *times;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (i + 1 == argc)
+            usage(argv[0]);
+        if (strcmp(argv[i], "--size") == 0)
+            size = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--repeat") == 0)
+            repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--warmup") == 0)
+            warmup = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            seed = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--shape") == 0)
+            only = argv[++i];
+        else if (strcmp(argv[i], "--budget") == 0)
+            budget = atof(argv[++i]);
+        else if (strcmp(argv[i], "--mode") == 0)
+        {
+            for (onlyMode = 0; onlyMode < MODES && strcmp(argv[i + 1], modeName[onlyMode]) != 0; onlyMode++)
+                ;
+            if (onlyMode == MODES)
+                usage(argv[0]);
+            i++;
+        }
+        else
+            usage(argv[0]);
+    }
+    if (repeat < 1)
+        repeat = 1;
+    times = malloc(repeat * sizeof(double));
+    listing = fopen("/dev/null", "w");
+    if (times == NULL || listing == NULL)
+        return 1;
+
+    printf("%-10s %7s %8s %10s %8s %8s %8s %8s %10s\n",
+           "shape", "mode", "bytes", "tokens", "min ms", "med ms", "MB/s", "Mtok/s", "tree MB");
+    for (k = 0; k < SHAPES; k++)
+    {
+        const Shape *s = &shapes[k];
+        long tokens;
+        char *text;
+        Run run;
+        if (only != NULL && strcmp(only, s->name) != 0)
+            continue;
+        initShape(&shape);
+        shape.size = size;
+        shape.functions = s->functions;
+        shape.depth = s->depth;
+        shape.exprLen = s->exprLen;
+        shape.comments = s->comments;
+        shape.idents = s->idents;
+        shape.seed = seed;
+        text = genProgram(&shape, &len);
+        if (text == NULL)
+        {
+            fprintf(stderr, "Out of memory error\n");
+            return 1;
+        }
+        runOnce(ScanMode, text, len, &run);
+        tokens = run.tokens;
+
+        for (m = 0; m < MODES; m++)
+        {
+            if (onlyMode >= 0 && m != onlyMode)
+                continue;
+            for (i = 0; i < warmup; i++)
+                runOnce(m, text, len, &run);
+            for (i = 0; i < repeat; i++)
+            {
+                double start = seconds();
+                runOnce(m, text, len, &run);
+                times[i] = seconds() - start;
+            }
+            qsort(times, repeat, sizeof(double), byTime);
+            printf("%-10s %7s %8zu %10ld %8.2f %8.2f %8.1f %8.2f %10.1f",
+                   s->name, modeName[m], len, tokens, times[0] * 1e3, times[repeat / 2] * 1e3,
+                   len / times[0] / 1e6, tokens / times[0] / 1e6, run.treeBytes / 1e6);
+            if (run.errors > 0)
+                printf("  %d syntax errors", run.errors);
+            if (run.semanticErrors > 0)
+                printf("  %d semantic errors", run.semanticErrors);
+            if (m == ParseMode && budget > 0 && len / times[0] / 1e6 < budget)
+            {
+                printf("  over budget");
+                overBudget = 1;
+            }
+            printf("\n");
+        }
+        free(text);
+    }
+    free(times);
+    getrusage(RUSAGE_SELF, &ru);
+    printf("peak RSS %.1f MB\n", ru.ru_maxrss / 1024.0);
+    return overBudget;
+}
@@ -0,0 +1,94 @@
+/* scanbench: scanner throughput benchmark.
+ * Writes a synthetic C- program of about 16 MB to a
+ * temporary file (or takes the file named on the
+ * command line) and runs getToken over it once,
+ * reporting MB/s and tokens/s. The Makefile links it
+ * against both scanner backends (scanbench-switch and
+ * scanbench-table) so the two can be compared.
+ */
+#include "globals.h"
+#include "scan.h"
+#include "util.h"
+#include "parse.h"
+
+#include <time.h>
+
+/* globals normally allocated by main.c */
+int lineno = 0;
+FILE *source;
+FILE *listing;
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+
+#define TARGET_BYTES (16L << 20)
+
+static const char *unit =
+    "/* find the position of the smallest element\n"
+    "   between low and high */\n"
+    "int minloc ( int a[], int low, int high )\n"
+    "{\tint i; int x; int k;\n"
+    "\tk = low;\n"
+    "\tx = a[low];\n"
+    "\ti = low + 1;\n"
+    "\twhile (i < high)\n"
+    "\t{\tif (a[i] < x)\n"
+    "\t\t{\tx = a[i];\n"
+    "\t\t\tk = i; }\n"
+    "\t\ti = i + 1;\n"
+    "\t}\n"
+    "\treturn k;\n"
+    "}\n\n";
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    CMinusParser ps;
+    long bytes = 0, tokens = 0;
+    size_t unitLen = strlen(unit);
+    double start, elapsed;
+    listing = stdout;
+    source = argc > 1 ? fopen(argv[1], "r") : tmpfile();
+    if (source == NULL)
+    {
+        perror(argc > 1 ? argv[1] : "scanbench: tmpfile");
+        return 1;
+    }
+    if (argc > 1)
+    {
+        fseek(source, 0, SEEK_END);
+        bytes = ftell(source);
+        rewind(source);
+    }
+    else
+    {
+        while (bytes < TARGET_BYTES)
+        {
+            fwrite(unit, 1, unitLen, source);
+            bytes += unitLen;
+        }
+        fflush(source);
+        rewind(source);
+    }
+
+    initParser(&ps, source, listing);
+    start = seconds();
+    while (getTokenWith(&ps) != ENDFILE)
+        tokens++;
+    elapsed = seconds() - start;
+
+#ifdef TABLE_SCANNER
+    printf("table scanner : ");
+#else
+    printf("switch scanner: ");
+#endif
+    printf("%7.1f MB/s %7.1f M tokens/s (%ld lines)\n",
+           bytes / elapsed / 1e6, tokens / elapsed / 1e6, (long)ps.lineno);
+    return 0;
+}
@@ -0,0 +1,318 @@
+/* vmbench: speed of running C- programs on the
+ * bytecode VM (see vm.h) against walking their trees
+ * with the interpreter (see interp.h). Each kernel is
+ * a loop-heavy program: nested counting loops, a sieve
+ * over a global array, a bubble sort through an array
+ * param, recursive calls, and a synthetic program (see
+ * gen.h) run with calls. It is parsed and analyzed
+ * once, then run both ways; the fastest of the timed
+ * runs is reported, with the time compiling took. Its
+ * tree folded (see fold.h) is run once more, and the
+ * last kernels stop on runtime errors inside x*0, which
+ * folding must keep. The run fails if any two of these
+ * ever write different output or one of them fails and
+ * the other not.
+ */
+#include "globals.h"
+#include "scan.h"
+#include "parse.h"
+#include "analyze.h"
+#include "fold.h"
+#include "interp.h"
+#include "vm.h"
+#include "gen.h"
+
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* globals normally allocated by main.c */
+int lineno = 0;
+FILE *source;
+FILE *listing;
+int EchoSource = FALSE;
+int TraceScan = FALSE;
+int TraceParse = FALSE;
+int FoldConstants = FALSE;
+
+typedef struct
+{
+    const char *name;
+    const char *text; /* NULL for a generated program */
+} Kernel;
+
+static const Kernel kernels[] = {
+    {"loops",
+     "void main(void)\n"
+     "{\n"
+     "    int i; int j; int s;\n"
+     "    s = 0; i = 0;\n"
+     "    while (i < 3000)\n"
+     "    {\n"
+     "        j = 0;\n"
+     "        while (j < 1000)\n"
+     "        {\n"
+     "            if (j / 3 * 3 == j) s = s + i; else s = s - j;\n"
+     "            j = j + 1;\n"
+     "        }\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    output(s);\n"
+     "}\n"},
+    {"sieve",
+     "int flags[200000];\n"
+     "int sieve(int n)\n"
+     "{\n"
+     "    int i; int j; int count;\n"
+     "    i = 0;\n"
+     "    while (i < n) { flags[i] = 1; i = i + 1; }\n"
+     "    count = 0; i = 2;\n"
+     "    while (i < n)\n"
+     "    {\n"
+     "        if (flags[i])\n"
+     "        {\n"
+     "            count = count + 1;\n"
+     "            j = i + i;\n"
+     "            while (j < n) { flags[j] = 0; j = j + i; }\n"
+     "        }\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    return count;\n"
+     "}\n"
+     "void main(void)\n"
+     "{\n"
+     "    int k;\n"
+     "    k = 0;\n"
+     "    while (k < 10) { output(sieve(200000)); k = k + 1; }\n"
+     "}\n"},
+    {"sort",
+     "void sort(int a[], int n)\n"
+     "{\n"
+     "    int i; int j; int t;\n"
+     "    i = 0;\n"
+     "    while (i < n - 1)\n"
+     "    {\n"
+     "        j = 0;\n"
+     "        while (j < n - 1 - i)\n"
+     "        {\n"
+     "            if (a[j] > a[j + 1]) { t = a[j]; a[j] = a[j + 1]; a[j + 1] = t; }\n"
+     "            j = j + 1;\n"
+     "        }\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "}\n"
+     "void main(void)\n"
+     "{\n"
+     "    int a[3000]; int i; int x;\n"
+     "    x = 1; i = 0;\n"
+     "    while (i < 3000)\n"
+     "    {\n"
+     "        x = x * 75 + 74; x = x - x / 65537 * 65537;\n"
+     "        a[i] = x; i = i + 1;\n"
+     "    }\n"
+     "    sort(a, 3000);\n"
+     "    output(a[0]); output(a[1500]); output(a[2999]);\n"
+     "}\n"},
+    {"fib",
+     "int fib(int n)\n"
+     "{\n"
+     "    if (n < 2) return n;\n"
+     "    return fib(n - 1) + fib(n - 2);\n"
+     "}\n"
+     "void main(void) { output(fib(27)); }\n"},
+    {"generated", NULL},
+    {"div-fault",
+     "void main(void)\n"
+     "{\n"
+     "    int i; int y;\n"
+     "    i = 3; y = 0;\n"
+     "    while (i > 0) { output((i / (y + 1)) * 0 + i); i = i - 1; }\n"
+     "    output((1 / y) * 0);\n"
+     "}\n"},
+    {"index-fault",
+     "int a[3];\n"
+     "void main(void)\n"
+     "{\n"
+     "    int i;\n"
+     "    i = 0;\n"
+     "    while (i < 5) { output(0 * a[i] + i); i = i + 1; }\n"
+     "}\n"},
+};
+
+#define KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* parseKernel parses and analyzes the len chars at
+   text with ps, folding the tree if fold is set; NULL
+   if there are errors */
+static TreeNode *parseKernel(CMinusParser *ps, const char *text, size_t len, int fold)
+{
+    TreeNode *tree;
+    initParser(ps, NULL, listing);
+    setSourceText(ps, text, text + len, text + len, 1, FALSE);
+    tree = parseWith(ps);
+    if (ps->errorCount > 0 || analyzeWith(ps, tree) > 0 || (fold && foldTree(tree) < 0))
+        return NULL;
+    return tree;
+}
+
+/* quiet sends stderr, where runtime errors go, to
+   /dev/null, or back where it was */
+static void quiet(int on)
+{
+    static int saved = -1;
+    int null;
+    fflush(stderr);
+    if (on && saved < 0 && (null = open("/dev/null", O_WRONLY)) >= 0)
+    {
+        saved = dup(2);
+        dup2(null, 2);
+        close(null);
+    }
+    else if (!on && saved >= 0)
+    {
+        dup2(saved, 2);
+        close(saved);
+        saved = -1;
+    }
+}
+
+/* sameOutput tells whether files a and b hold the
+   same bytes, and empties both for the next run */
+static int sameOutput(FILE *a, FILE *b)
+{
+    int x, y;
+    rewind(a);
+    rewind(b);
+    do
+    {
+        x = getc(a);
+        y = getc(b);
+    } while (x == y && x != EOF);
+    rewind(a);
+    rewind(b);
+    return x == y && ftruncate(fileno(a), 0) == 0 && ftruncate(fileno(b), 0) == 0;
+}
+
+static void usage(char *prog)
+{
+    size_t k;
+    fprintf(stderr, "usage: %s [--repeat <n>] [--kernel <name>]\n", prog);
+    fprintf(stderr, "kernels:");
+    for (k = 0; k < KERNELS; k++)
+        fprintf(stderr, " %s", kernels[k].name);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    GenShape shape;
+    const char *only = NULL;
+    int repeat = 3, i, differ = 0;
+    size_t k, len;
+    FILE *treeOut, *vmOut;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (i + 1 == argc)
+            usage(argv[0]);
+        if (strcmp(argv[i], "--repeat") == 0)
+            repeat = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--kernel") == 0)
+            only = argv[++i];
+        else
+            usage(argv[0]);
+    }
+    if (repeat < 1)
+        repeat = 1;
+    listing = fopen("/dev/null", "w");
+    treeOut = tmpfile();
+    vmOut = tmpfile();
+    if (listing == NULL || treeOut == NULL || vmOut == NULL)
+        return 1;
+
+    printf("%-11s %10s %10s %10s %8s %10s\n", "kernel", "code ints", "tree ms", "compile ms", "vm ms", "speedup");
+    for (k = 0; k < KERNELS; k++)
+    {
+        const Kernel *kn = &kernels[k];
+        char *text;
+        CMinusParser ps, foldPs;
+        TreeNode *tree, *folded;
+        Bytecode bc;
+        double start, treeMs = 0, compileMs = 0, vmMs = 0, t;
+        int same = TRUE, foldSame, treeFailed, vmFailed;
+        if (only != NULL && strcmp(only, kn->name) != 0)
+            continue;
+        if (kn->text != NULL)
+        {
+            len = strlen(kn->text);
+            text = malloc(len + 1);
+            if (text != NULL)
+                memcpy(text, kn->text, len + 1);
+        }
+        else
+        {
+            initShape(&shape);
+            shape.size = 200000;
+            shape.functions = 20;
+            shape.calls = 50000;
+            text = genProgram(&shape, &len);
+        }
+        if (text == NULL)
+        {
+            fprintf(stderr, "Out of memory error\n");
+            return 1;
+        }
+        tree = parseKernel(&ps, text, len, FALSE);
+        folded = parseKernel(&foldPs, text, len, TRUE);
+        if (tree == NULL || folded == NULL)
+        {
+            fprintf(stderr, "%s: kernel has errors\n", kn->name);
+            return 1;
+        }
+        quiet(TRUE);
+        for (i = 0; i < repeat; i++)
+        {
+            start = seconds();
+            treeFailed = runProgram(tree, stdin, treeOut);
+            t = seconds() - start;
+            treeMs = i == 0 || t < treeMs ? t : treeMs;
+
+            start = seconds();
+            if (compileProgram(tree, &bc) < 0)
+            {
+                fprintf(stderr, "Out of memory error\n");
+                return 1;
+            }
+            t = seconds() - start;
+            compileMs = i == 0 || t < compileMs ? t : compileMs;
+
+            start = seconds();
+            vmFailed = runBytecode(&bc, stdin, vmOut);
+            t = seconds() - start;
+            vmMs = i == 0 || t < vmMs ? t : vmMs;
+            same = sameOutput(treeOut, vmOut) && treeFailed == vmFailed && same;
+            len = bc.count;
+            freeBytecode(&bc);
+        }
+        treeFailed = runProgram(tree, stdin, treeOut);
+        vmFailed = runProgram(folded, stdin, vmOut);
+        foldSame = sameOutput(treeOut, vmOut) && treeFailed == vmFailed;
+        quiet(FALSE);
+        printf("%-11s %10zu %10.2f %10.3f %8.2f %9.2fx%s%s\n", kn->name, len, treeMs * 1e3, compileMs * 1e3,
+               vmMs * 1e3, treeMs / vmMs, same ? "" : "  outputs differ",
+               foldSame ? "" : "  folded run differs");
+        differ = differ || !same || !foldSame;
+        closeParser(&ps);
+        closeParser(&foldPs);
+        free(text);
+    }
+    return differ;
+}
@@ -0,0 +1,465 @@
+#include "globals.h"
+#include "astfile.h"
+#include "cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+/* An entry file holds an EntryHeader, the listing
+   text, padding to 8 bytes and then an AST file */
+#define ENTRY_MAGIC "CMCACHE2"
+#define ENTRY_SUFFIX ".ent"
+
+typedef struct
+{
+    char magic[8]; /* ENTRY_MAGIC */
+    CacheKey key;
+    unsigned long long sourceLen;
+    unsigned long long listingLen;
+    unsigned long long astOffset;
+    unsigned long long astLen;
+    int errors;
+    int semanticErrors;
+} EntryHeader;
+
+/**************************************************/
+/* 64-bit hash in the style of xxHash64: four      */
+/* independent lanes take 32-byte stripes, so the  */
+/* loop runs at several bytes per cycle            */
+/**************************************************/
+
+#define PRIME1 0x9E3779B185EBCA87ULL
+#define PRIME2 0xC2B2AE3D27D4EB4FULL
+#define PRIME3 0x165667B19E3779F9ULL
+#define PRIME4 0x85EBCA77C2B2AE63ULL
+#define PRIME5 0x27D4EB2F165667C5ULL
+
+#define ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static unsigned long long read64(const unsigned char *p)
+{
+    unsigned long long v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static unsigned read32(const unsigned char *p)
+{
+    unsigned v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static unsigned long long hashRound(unsigned long long acc, unsigned long long input)
+{
+    acc += input * PRIME2;
+    acc = ROTL(acc, 31);
+    return acc * PRIME1;
+}
+
+static unsigned long long hashMerge(unsigned long long acc, unsigned long long lane)
+{
+    acc ^= hashRound(0, lane);
+    return acc * PRIME1 + PRIME4;
+}
+
+/* hash64 hashes the len bytes at data */
+static unsigned long long hash64(const void *data, size_t len, unsigned long long seed)
+{
+    const unsigned char *p = data, *end = p + len;
+    unsigned long long h;
+    if (len >= 32)
+    {
+        unsigned long long v1 = seed + PRIME1 + PRIME2, v2 = seed + PRIME2;
+        unsigned long long v3 = seed, v4 = seed - PRIME1;
+        do
+        {
+            v1 = hashRound(v1, read64(p));
+            v2 = hashRound(v2, read64(p + 8));
+            v3 = hashRound(v3, read64(p + 16));
+            v4 = hashRound(v4, read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+        h = ROTL(v1, 1) + ROTL(v2, 7) + ROTL(v3, 12) + ROTL(v4, 18);
+        h = hashMerge(h, v1);
+        h = hashMerge(h, v2);
+        h = hashMerge(h, v3);
+        h = hashMerge(h, v4);
+    }
+    else
+        h = seed + PRIME5;
+    h += len;
+    for (; end - p >= 8; p += 8)
+    {
+        h ^= hashRound(0, read64(p));
+        h = ROTL(h, 27) * PRIME1 + PRIME4;
+    }
+    if (end - p >= 4)
+    {
+        h ^= (unsigned long long)read32(p) * PRIME1;
+        h = ROTL(h, 23) * PRIME2 + PRIME3;
+        p += 4;
+    }
+    for (; p < end; p++)
+    {
+        h ^= *p * PRIME5;
+        h = ROTL(h, 11) * PRIME1;
+    }
+    h ^= h >> 33;
+    h *= PRIME2;
+    h ^= h >> 29;
+    h *= PRIME3;
+    h ^= h >> 32;
+    return h;
+}
+
+/* Function cacheKey returns the key of a source text:
+ * a 64-bit hash of its bytes, the parser version and
+ * the tracing flags that shape the listing
+ */
+CacheKey cacheKey(const char *text, size_t len)
+{
+    int config[6];
+    config[0] = PARSER_VERSION;
+    config[1] = AST_FILE_VERSION;
+    config[2] = EchoSource;
+    config[3] = TraceScan;
+    config[4] = TraceParse;
+    config[5] = FoldConstants;
+    return hash64(text, len, hash64(config, sizeof(config), 0));
+}
+
+/**************************************************/
+/* entries                                        */
+/**************************************************/
+
+/* entryPath names the entry file of key */
+static void entryPath(Cache *cache, CacheKey key, char *path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx" ENTRY_SUFFIX, cache->dir, key);
+}
+
+/* copyBytes copies n bytes from one stream to the
+   other; returns 0, or -1 if either side fails */
+static int copyBytes(FILE *from, FILE *to, unsigned long long n)
+{
+    char buf[64 * 1024];
+    while (n > 0)
+    {
+        size_t chunk = n < sizeof(buf) ? (size_t)n : sizeof(buf);
+        if (fread(buf, 1, chunk, from) != chunk || fwrite(buf, 1, chunk, to) != chunk)
+            return -1;
+        n -= chunk;
+    }
+    return 0;
+}
+
+static void count(Cache *cache, long *counter)
+{
+    pthread_mutex_lock(&cache->lock);
+    (*counter)++;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/* Function openCache opens the cache in dir, creating
+ * the directory if needed; NULL if it cannot be used
+ */
+Cache *openCache(const char *dir, long long maxBytes)
+{
+    struct stat st;
+    Cache *cache;
+    if (mkdir(dir, 0777) < 0 && (stat(dir, &st) < 0 || !S_ISDIR(st.st_mode)))
+        return NULL;
+    cache = calloc(1, sizeof(Cache));
+    if (cache == NULL)
+        return NULL;
+    cache->dir = malloc(strlen(dir) + 1);
+    if (cache->dir == NULL)
+    {
+        free(cache);
+        return NULL;
+    }
+    strcpy(cache->dir, dir);
+    cache->maxBytes = maxBytes > 0 ? maxBytes : CACHE_DEFAULT_BYTES;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+/* Function cacheFetch looks up the entry for key and
+ * a source text of len bytes. On a hit it copies the
+ * listing to listing, the AST file to astPath unless
+ * that is NULL, stores the syntax and semantic error
+ * counts in errors and semanticErrors and returns TRUE;
+ * otherwise returns FALSE
+ */
+int cacheFetch(Cache *cache, CacheKey key, size_t len, FILE *listing,
+               const char *astPath, int *errors, int *semanticErrors)
+{
+    char path[FILENAME_MAX];
+    EntryHeader h;
+    FILE *f, *ast;
+    int ok;
+
+    entryPath(cache, key, path, sizeof(path));
+    f = fopen(path, "rb");
+    ok = f != NULL && fread(&h, sizeof(h), 1, f) == 1 &&
+         memcmp(h.magic, ENTRY_MAGIC, sizeof(h.magic)) == 0 &&
+         h.key == key && h.sourceLen == len;
+    if (ok && astPath != NULL)
+    {
+        ast = fopen(astPath, "wb");
+        ok = ast != NULL && fseek(f, (long)h.astOffset, SEEK_SET) == 0 &&
+             copyBytes(f, ast, h.astLen) == 0;
+        if (ast != NULL && fclose(ast) != 0)
+            ok = FALSE;
+    }
+    if (ok)
+        ok = fseek(f, sizeof(h), SEEK_SET) == 0 && copyBytes(f, listing, h.listingLen) == 0;
+    if (f != NULL)
+        fclose(f);
+    if (!ok)
+    {
+        count(cache, &cache->misses);
+        return FALSE;
+    }
+    /* the modification time orders entries for eviction */
+    utimensat(AT_FDCWD, path, NULL, 0);
+    *errors = h.errors;
+    *semanticErrors = h.semanticErrors;
+    count(cache, &cache->hits);
+    return TRUE;
+}
+
+/* Procedure cacheStore records the listing already
+ * written to the file listingPath, the tree and the
+ * syntax and semantic error counts as the entry for
+ * key and a source text of len bytes; failures just
+ * leave the entry out
+ */
+void cacheStore(Cache *cache, CacheKey key, size_t len, const char *listingPath,
+                const CompactAst *ast, int errors, int semanticErrors)
+{
+    static const char zeros[8];
+    char tmp[FILENAME_MAX], path[FILENAME_MAX];
+    EntryHeader h;
+    FILE *f, *text;
+    struct stat st;
+    long pos;
+    int fd, ok;
+
+    if (ast == NULL || stat(listingPath, &st) < 0)
+        return;
+    snprintf(tmp, sizeof(tmp), "%s/tmpXXXXXX", cache->dir);
+    fd = mkstemp(tmp);
+    if (fd < 0)
+        return;
+    /* entries are shared like ordinary output files */
+    fchmod(fd, 0644);
+    f = fdopen(fd, "wb");
+    if (f == NULL)
+    {
+        close(fd);
+        unlink(tmp);
+        return;
+    }
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, ENTRY_MAGIC, sizeof(h.magic));
+    h.key = key;
+    h.sourceLen = len;
+    h.listingLen = st.st_size;
+    h.errors = errors;
+    h.semanticErrors = semanticErrors;
+
+    text = fopen(listingPath, "rb");
+    ok = text != NULL && fwrite(&h, sizeof(h), 1, f) == 1 &&
+         copyBytes(text, f, h.listingLen) == 0;
+    if (text != NULL)
+        fclose(text);
+    if (ok)
+    {
+        pos = ftell(f);
+        ok = pos >= 0 && fwrite(zeros, 1, (8 - pos % 8) % 8, f) == (size_t)((8 - pos % 8) % 8);
+    }
+    if (ok)
+    {
+        h.astOffset = ftell(f);
+        ok = writeAstFileTo(ast, f) == 0;
+        h.astLen = ftell(f) - h.astOffset;
+    }
+    ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, f) == 1;
+    if (fclose(f) != 0)
+        ok = FALSE;
+    entryPath(cache, key, path, sizeof(path));
+    if (!ok || rename(tmp, path) < 0)
+    {
+        unlink(tmp);
+        return;
+    }
+    count(cache, &cache->stores);
+}
+
+/**************************************************/
+/* stats and eviction                             */
+/**************************************************/
+
+typedef struct
+{
+    char *name;
+    long long size;
+    struct timespec used;
+} EntryFile;
+
+static int olderFirst(const void *a, const void *b)
+{
+    const EntryFile *x = a, *y = b;
+    if (x->used.tv_sec != y->used.tv_sec)
+        return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+    if (x->used.tv_nsec != y->used.tv_nsec)
+        return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+/* evict removes the least recently used entries until
+   the directory fits its size bound; returns how many
+   were removed */
+static long evict(Cache *cache)
+{
+    char path[FILENAME_MAX];
+    EntryFile *files = NULL;
+    int n = 0, cap = 0, i;
+    long long total = 0;
+    long removed = 0;
+    struct dirent *d;
+    DIR *dir = opendir(cache->dir);
+    if (dir == NULL)
+        return 0;
+    while ((d = readdir(dir)) != NULL)
+    {
+        struct stat st;
+        size_t len = strlen(d->d_name);
+        if (len <= strlen(ENTRY_SUFFIX) ||
+            strcmp(d->d_name + len - strlen(ENTRY_SUFFIX), ENTRY_SUFFIX) != 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, d->d_name);
+        if (stat(path, &st) < 0)
+            continue;
+        if (n == cap)
+        {
+            EntryFile *grown = realloc(files, (cap = cap ? cap * 2 : 64) * sizeof(EntryFile));
+            if (grown == NULL)
+                break;
+            files = grown;
+        }
+        files[n].name = malloc(len + 1);
+        if (files[n].name == NULL)
+            break;
+        strcpy(files[n].name, d->d_name);
+        files[n].size = st.st_size;
+        files[n].used = st.st_mtim;
+        total += st.st_size;
+        n++;
+    }
+    closedir(dir);
+    if (total > cache->maxBytes)
+        qsort(files, n, sizeof(EntryFile), olderFirst);
+    for (i = 0; i < n; i++)
+    {
+        if (total > cache->maxBytes)
+        {
+            snprintf(path, sizeof(path), "%s/%s", cache->dir, files[i].name);
+            if (unlink(path) == 0)
+            {
+                total -= files[i].size;
+                removed++;
+            }
+        }
+        free(files[i].name);
+    }
+    free(files);
+    return removed;
+}
+
+/* readStats reads the four counts of a stats file */
+static void readStats(FILE *f, long counts[4])
+{
+    char name[32];
+    long value;
+    counts[0] = counts[1] = counts[2] = counts[3] = 0;
+    while (fscanf(f, "%31s %ld", name, &value) == 2)
+    {
+        if (strcmp(name, "hits") == 0)
+            counts[0] = value;
+        else if (strcmp(name, "misses") == 0)
+            counts[1] = value;
+        else if (strcmp(name, "stores") == 0)
+            counts[2] = value;
+        else if (strcmp(name, "evictions") == 0)
+            counts[3] = value;
+    }
+}
+
+/* Procedure closeCache adds this run's counts to the
+ * stats file, evicts entries down to the size bound
+ * and releases the cache
+ */
+void closeCache(Cache *cache)
+{
+    char path[FILENAME_MAX];
+    long counts[4];
+    FILE *f;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/stats", cache->dir);
+    fd = open(path, O_RDWR | O_CREAT, 0666);
+    f = fd < 0 ? NULL : fdopen(fd, "r+");
+    if (f == NULL)
+    {
+        if (fd >= 0)
+            close(fd);
+        cache->evictions += evict(cache);
+    }
+    else
+    {
+        /* one run at a time updates the counts and evicts */
+        flock(fd, LOCK_EX);
+        cache->evictions += evict(cache);
+        readStats(f, counts);
+        rewind(f);
+        fprintf(f, "hits %ld\nmisses %ld\nstores %ld\nevictions %ld\n",
+                counts[0] + cache->hits, counts[1] + cache->misses,
+                counts[2] + cache->stores, counts[3] + cache->evictions);
+        fflush(f);
+        ftruncate(fd, ftell(f));
+        flock(fd, LOCK_UN);
+        fclose(f);
+    }
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->dir);
+    free(cache);
+}
+
+/* Function printCacheStats prints the counts in the
+ * stats file of the cache in dir; returns 0, or 1 if
+ * there is none
+ */
+int printCacheStats(const char *dir)
+{
+    char path[FILENAME_MAX];
+    long counts[4];
+    FILE *f;
+    snprintf(path, sizeof(path), "%s/stats", dir);
+    f = fopen(path, "r");
+    if (f == NULL)
+        return 1;
+    flock(fileno(f), LOCK_SH);
+    readStats(f, counts);
+    fclose(f);
+    printf("hits %ld\nmisses %ld\nstores %ld\nevictions %ld\n",
+           counts[0], counts[1], counts[2], counts[3]);
+    if (counts[0] + counts[1] > 0)
+        printf("hit rate %.1f%%\n", 100.0 * counts[0] / (counts[0] + counts[1]));
+    return 0;
+}
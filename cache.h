@@ -0,0 +1,75 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include <pthread.h>
+
+#include "ast.h"
+
+/* A Cache remembers the listing, syntax and semantic
+ * error counts and binary AST produced for a source text, in a
+ * directory of entry files named by the text's key,
+ * so an unchanged file is answered without scanning
+ * or parsing it. Entries are written to a temporary
+ * file and renamed into place, so concurrent runs
+ * sharing a directory never see half an entry.
+ * When the directory grows past its size bound the
+ * least recently used entries are removed. Hit, miss,
+ * store and eviction counts are added up across runs
+ * in the directory's stats file.
+ */
+typedef unsigned long long CacheKey;
+
+typedef struct
+{
+    char *dir;
+    long long maxBytes; /* size bound of the directory */
+    pthread_mutex_t lock; /* guards the counts below */
+    long hits, misses, stores, evictions;
+} Cache;
+
+/* default size bound of a cache directory */
+#define CACHE_DEFAULT_BYTES (64LL * 1024 * 1024)
+
+/* Function openCache opens the cache in dir, creating
+ * the directory if needed; NULL if it cannot be used
+ */
+Cache *openCache(const char *dir, long long maxBytes);
+
+/* Function cacheKey returns the key of a source text:
+ * a 64-bit hash of its bytes, the parser version and
+ * the tracing flags that shape the listing
+ */
+CacheKey cacheKey(const char *text, size_t len);
+
+/* Function cacheFetch looks up the entry for key and
+ * a source text of len bytes. On a hit it copies the
+ * listing to listing, the AST file to astPath unless
+ * that is NULL, stores the syntax and semantic error
+ * counts in errors and semanticErrors and returns TRUE;
+ * otherwise returns FALSE
+ */
+int cacheFetch(Cache *, CacheKey key, size_t len, FILE *listing,
+               const char *astPath, int *errors, int *semanticErrors);
+
+/* Procedure cacheStore records the listing already
+ * written to the file listingPath, the tree and the
+ * syntax and semantic error counts as the entry for
+ * key and a source text of len bytes; failures just
+ * leave the entry out
+ */
+void cacheStore(Cache *, CacheKey key, size_t len, const char *listingPath,
+                const CompactAst *ast, int errors, int semanticErrors);
+
+/* Procedure closeCache adds this run's counts to the
+ * stats file, evicts entries down to the size bound
+ * and releases the cache
+ */
+void closeCache(Cache *);
+
+/* Function printCacheStats prints the counts in the
+ * stats file of the cache in dir; returns 0, or 1 if
+ * there is none
+ */
+int printCacheStats(const char *dir);
+
+#endif
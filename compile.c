@@ -0,0 +1,688 @@
+#include "globals.h"
+#include "walk.h"
+#include "vm.h"
+
+#include <pthread.h>
+
+/* C stack for the thread compiling a program: the
+   compiler recurses on nested expressions, and an
+   operator chain may be hundreds of thousands long */
+#define COMPILE_THREAD_STACK (256L << 20)
+
+const int opArgs[OPCODES] = {
+    [OP_HALT] = 0, [OP_KONST] = 2, [OP_MOVE] = 2, [OP_GETG] = 2, [OP_SETG] = 2,
+    [OP_ADDR] = 2, [OP_ADD] = 3, [OP_SUB] = 3, [OP_MUL] = 3, [OP_DIV] = 3,
+    [OP_ADDK] = 3, [OP_SUBK] = 3, [OP_MULK] = 3, [OP_DIVK] = 3, [OP_LT] = 3,
+    [OP_LE] = 3, [OP_GT] = 3, [OP_GE] = 3, [OP_EQ] = 3, [OP_NE] = 3,
+    [OP_JMP] = 1, [OP_JZ] = 2, [OP_JNZ] = 2, [OP_JLT] = 3, [OP_JLE] = 3,
+    [OP_JGT] = 3, [OP_JGE] = 3, [OP_JEQ] = 3, [OP_JNE] = 3, [OP_JLTK] = 3,
+    [OP_JLEK] = 3, [OP_JGTK] = 3, [OP_JGEK] = 3, [OP_JEQK] = 3, [OP_JNEK] = 3,
+    [OP_GETL] = 4, [OP_SETL] = 4, [OP_GETGA] = 4, [OP_SETGA] = 4, [OP_GETP] = 3,
+    [OP_SETP] = 3, [OP_CALL] = 3, [OP_RET] = 1, [OP_RET0] = 0, [OP_IN] = 1,
+    [OP_OUT] = 1,
+};
+
+const char *const opOperands[OPCODES] = {
+    [OP_HALT] = "", [OP_KONST] = "rk", [OP_MOVE] = "rr", [OP_GETG] = "rg", [OP_SETG] = "gr",
+    [OP_ADDR] = "rr", [OP_ADD] = "rrr", [OP_SUB] = "rrr", [OP_MUL] = "rrr", [OP_DIV] = "rrr",
+    [OP_ADDK] = "rrk", [OP_SUBK] = "rrk", [OP_MULK] = "rrk", [OP_DIVK] = "rrk", [OP_LT] = "rrr",
+    [OP_LE] = "rrr", [OP_GT] = "rrr", [OP_GE] = "rrr", [OP_EQ] = "rrr", [OP_NE] = "rrr",
+    [OP_JMP] = "j", [OP_JZ] = "rj", [OP_JNZ] = "rj", [OP_JLT] = "rrj", [OP_JLE] = "rrj",
+    [OP_JGT] = "rrj", [OP_JGE] = "rrj", [OP_JEQ] = "rrj", [OP_JNE] = "rrj", [OP_JLTK] = "rkj",
+    [OP_JLEK] = "rkj", [OP_JGTK] = "rkj", [OP_JGEK] = "rkj", [OP_JEQK] = "rkj", [OP_JNEK] = "rkj",
+    [OP_GETL] = "rrrk", [OP_SETL] = "rrkr", [OP_GETGA] = "rgrk", [OP_SETGA] = "grkr", [OP_GETP] = "rrr",
+    [OP_SETP] = "rrr", [OP_CALL] = "rfr", [OP_RET] = "r", [OP_RET0] = "", [OP_IN] = "r",
+    [OP_OUT] = "r",
+};
+
+const char *const opName[OPCODES] = {
+    [OP_HALT] = "HALT", [OP_KONST] = "KONST", [OP_MOVE] = "MOVE", [OP_GETG] = "GETG",
+    [OP_SETG] = "SETG", [OP_ADDR] = "ADDR", [OP_ADD] = "ADD", [OP_SUB] = "SUB",
+    [OP_MUL] = "MUL", [OP_DIV] = "DIV", [OP_ADDK] = "ADDK", [OP_SUBK] = "SUBK",
+    [OP_MULK] = "MULK", [OP_DIVK] = "DIVK", [OP_LT] = "LT", [OP_LE] = "LE",
+    [OP_GT] = "GT", [OP_GE] = "GE", [OP_EQ] = "EQ", [OP_NE] = "NE",
+    [OP_JMP] = "JMP", [OP_JZ] = "JZ", [OP_JNZ] = "JNZ", [OP_JLT] = "JLT",
+    [OP_JLE] = "JLE", [OP_JGT] = "JGT", [OP_JGE] = "JGE", [OP_JEQ] = "JEQ",
+    [OP_JNE] = "JNE", [OP_JLTK] = "JLTK", [OP_JLEK] = "JLEK", [OP_JGTK] = "JGTK",
+    [OP_JGEK] = "JGEK", [OP_JEQK] = "JEQK", [OP_JNEK] = "JNEK", [OP_GETL] = "GETL",
+    [OP_SETL] = "SETL", [OP_GETGA] = "GETGA", [OP_SETGA] = "SETGA", [OP_GETP] = "GETP",
+    [OP_SETP] = "SETP", [OP_CALL] = "CALL", [OP_RET] = "RET", [OP_RET0] = "RET0",
+    [OP_IN] = "IN", [OP_OUT] = "OUT",
+};
+
+/* a FuncK and the index of its VmFunc */
+typedef struct
+{
+    const TreeNode *func;
+    int index;
+} FuncSlot;
+
+/* the state of one compilation */
+typedef struct
+{
+    Bytecode *bc;
+    FuncSlot *funcs; /* hash table of the functions compiled */
+    unsigned funcCap;
+    int top;    /* first free temporary */
+    int maxTop; /* registers the function needs */
+    int copyVars; /* read variables into temporaries, as
+                     the function assigns inside expressions */
+    int failed;
+} Compiler;
+
+static void compileExp(Compiler *c, TreeNode *t, int dst);
+static int compileAssign(Compiler *c, TreeNode *t);
+static void compileStmt(Compiler *c, TreeNode *t);
+
+static int isStmt(const TreeNode *t, StmtKind kind)
+{
+    return t != NULL && t->nodekind == StmtK && t->kind.stmt == kind;
+}
+
+static int isExp(const TreeNode *t, ExpKind kind)
+{
+    return t != NULL && t->nodekind == ExpK && t->kind.exp == kind;
+}
+
+/**************************************************/
+/* emitting code                                  */
+/**************************************************/
+
+/* emit appends an instruction with up to four
+   operands, the ones op takes, and returns its
+   offset */
+static int emit(Compiler *c, const TreeNode *where, OpCode op, int a, int b, int d, int e)
+{
+    Bytecode *bc = c->bc;
+    int at = bc->count, operands[4];
+    int i;
+    if (bc->count + 5 > bc->cap)
+    {
+        int cap = bc->cap ? bc->cap * 2 : 1024;
+        int *code = realloc(bc->code, cap * sizeof(int));
+        const TreeNode **wh = code != NULL ? realloc(bc->where, cap * sizeof(TreeNode *)) : NULL;
+        if (code != NULL)
+            bc->code = code;
+        if (wh == NULL)
+        {
+            c->failed = TRUE;
+            return 0;
+        }
+        bc->where = wh;
+        bc->cap = cap;
+    }
+    operands[0] = a;
+    operands[1] = b;
+    operands[2] = d;
+    operands[3] = e;
+    bc->code[bc->count] = op;
+    bc->where[bc->count++] = where;
+    for (i = 0; i < opArgs[op]; i++)
+    {
+        bc->code[bc->count] = operands[i];
+        bc->where[bc->count++] = where;
+    }
+    return at;
+}
+
+/* patch points the jump at offset at to target */
+static void patch(Compiler *c, int at, int target)
+{
+    if (!c->failed)
+        c->bc->code[at + opArgs[c->bc->code[at]]] = target - at;
+}
+
+static int newTemp(Compiler *c)
+{
+    if (++c->top > c->maxTop)
+        c->maxTop = c->top;
+    return c->top - 1;
+}
+
+/**************************************************/
+/* functions                                      */
+/**************************************************/
+
+/* funcSlot returns the hash table slot of f, or the
+   empty one it would go in */
+static FuncSlot *funcSlot(const Compiler *c, const TreeNode *f)
+{
+    unsigned mask = c->funcCap - 1;
+    unsigned h = (unsigned)(((size_t)f >> 4) * 2654435761u) & mask;
+    while (c->funcs[h].func != NULL && c->funcs[h].func != f)
+        h = (h + 1) & mask;
+    return &c->funcs[h];
+}
+
+/* addFunc makes a VmFunc for the FuncK f and returns
+   its index, or -1 */
+static int addFunc(Compiler *c, const TreeNode *f)
+{
+    Bytecode *bc = c->bc;
+    const TreeNode *p;
+    VmFunc *fn;
+    unsigned i;
+    if (2 * (bc->funcCount + 1) > (int)c->funcCap)
+    {
+        Compiler grown = *c;
+        grown.funcCap = c->funcCap ? c->funcCap * 2 : 256;
+        grown.funcs = calloc(grown.funcCap, sizeof(FuncSlot));
+        if (grown.funcs == NULL)
+            return -1;
+        for (i = 0; i < c->funcCap; i++)
+            if (c->funcs[i].func != NULL)
+                *funcSlot(&grown, c->funcs[i].func) = c->funcs[i];
+        free(c->funcs);
+        c->funcs = grown.funcs;
+        c->funcCap = grown.funcCap;
+    }
+    if (bc->funcCount == bc->funcCap)
+    {
+        int cap = bc->funcCap ? bc->funcCap * 2 : 64;
+        VmFunc *funcs = realloc(bc->funcs, cap * sizeof(VmFunc));
+        if (funcs == NULL)
+            return -1;
+        bc->funcs = funcs;
+        bc->funcCap = cap;
+    }
+    fn = &bc->funcs[bc->funcCount];
+    fn->name = f->child[1]->attr.name;
+    fn->entry = bc->count;
+    fn->params = 0;
+    for (p = f->child[2]->child[0]; isStmt(p, ParamK); p = p->sibling)
+        fn->params = p->slot + (p->type == IntArray ? 2 : 1);
+    fn->frame = f->slot;
+    fn->regs = f->slot;
+    funcSlot(c, f)->func = f;
+    funcSlot(c, f)->index = bc->funcCount;
+    return bc->funcCount++;
+}
+
+/* findsAssign stops the walk at an assignment used
+   as a value */
+static int findsAssign(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    const TreeNode *p = pos->parent;
+    if (!isStmt(t, AssignK) || isStmt(p, CompK) || ((isStmt(p, IfK) || isStmt(p, WhileK)) && pos->slot > 0))
+        return WALK_CONTINUE;
+    return WALK_STOP;
+}
+
+/* compileFunc compiles the FuncK f */
+static void compileFunc(Compiler *c, TreeNode *f)
+{
+    int index = addFunc(c, f);
+    if (index < 0)
+    {
+        c->failed = TRUE;
+        return;
+    }
+    c->top = c->maxTop = f->slot;
+    c->copyVars = walkTree(f->child[3], findsAssign, NULL, NULL) != 0;
+    compileStmt(c, f->child[3]);
+    emit(c, f, OP_RET0, 0, 0, 0, 0);
+    c->bc->funcs[index].regs = c->maxTop;
+}
+
+/**************************************************/
+/* expressions                                    */
+/**************************************************/
+
+static int isLocal(const TreeNode *decl)
+{
+    return !IS_GLOBAL_SLOT(decl->slot);
+}
+
+static int arrayLength(const TreeNode *decl)
+{
+    return decl->child[1]->child[1]->attr.val;
+}
+
+/* operand returns a register holding the value of t:
+   a local variable's own, or a new temporary */
+static int operand(Compiler *c, TreeNode *t)
+{
+    int r;
+    if (isExp(t, IdK) && isLocal(t->decl) && !c->copyVars)
+        return t->decl->slot;
+    r = newTemp(c);
+    compileExp(c, t, r);
+    return r;
+}
+
+/* kOp gives the form of an arithmetic op with a
+   constant right operand, or -1 */
+static int kOp(TokenType op, int k)
+{
+    switch (op)
+    {
+    case PLUS:
+        return OP_ADDK;
+    case MINUS:
+        return OP_SUBK;
+    case TIMES:
+        return OP_MULK;
+    case OVER:
+        return k != 0 && k != -1 ? OP_DIVK : -1;
+    default:
+        return -1;
+    }
+}
+
+/* isPure tells whether evaluating t can neither fail
+   nor have an effect */
+static int isPure(const TreeNode *t)
+{
+    if (isExp(t, ConstK) || isExp(t, IdK))
+        return TRUE;
+    if (!isExp(t, OpK) || !isPure(t->child[0]) || !isPure(t->child[1]))
+        return FALSE;
+    return t->attr.op != OVER || kOp(OVER, isExp(t->child[1], ConstK) ? t->child[1]->attr.val : 0) >= 0;
+}
+
+/* rOp gives the register form of an op */
+static int rOp(TokenType op)
+{
+    switch (op)
+    {
+    case PLUS:
+        return OP_ADD;
+    case MINUS:
+        return OP_SUB;
+    case TIMES:
+        return OP_MUL;
+    case OVER:
+        return OP_DIV;
+    case LT:
+        return OP_LT;
+    case LE:
+        return OP_LE;
+    case GT:
+        return OP_GT;
+    case GE:
+        return OP_GE;
+    case EQ:
+        return OP_EQ;
+    default:
+        return OP_NE;
+    }
+}
+
+static void compileOp(Compiler *c, TreeNode *t, int dst)
+{
+    int mark = c->top, a = operand(c, t->child[0]), op;
+    TreeNode *r = t->child[1];
+    if (isExp(r, ConstK) && (op = kOp(t->attr.op, r->attr.val)) >= 0)
+        emit(c, t, op, dst, a, r->attr.val, 0);
+    else
+        emit(c, t, rOp(t->attr.op), dst, a, operand(c, r), 0);
+    c->top = mark;
+}
+
+/* compileElement reads the Arry_ElemK t into dst,
+   its index from register i, or -1 to compute it */
+static void compileElement(Compiler *c, TreeNode *t, int dst, int i)
+{
+    const TreeNode *decl = t->decl;
+    int mark = c->top;
+    if (i < 0)
+        i = operand(c, t->child[1]);
+    if (isStmt(decl, ParamK))
+        emit(c, t, OP_GETP, dst, decl->slot, i, 0);
+    else if (isLocal(decl))
+        emit(c, t, OP_GETL, dst, decl->slot, i, arrayLength(decl));
+    else
+        emit(c, t, OP_GETGA, dst, GLOBAL_SLOT(decl->slot), i, arrayLength(decl));
+    c->top = mark;
+}
+
+/* compileCall calls a function, its value going to
+   dst; the arguments are put where its frame begins */
+static void compileCall(Compiler *c, TreeNode *t, int dst)
+{
+    TreeNode *f = t->decl, *param, *arg = t->child[1] != NULL ? t->child[1]->child[0] : NULL;
+    const TreeNode *decl;
+    int base = c->top, mark = c->top, r;
+    if (f->child[3] == NULL) /* a built-in */
+    {
+        if (f->type == Integer)
+            emit(c, t, OP_IN, dst, 0, 0, 0);
+        else
+        {
+            emit(c, t, OP_OUT, operand(c, arg), 0, 0, 0);
+            c->top = mark;
+        }
+        return;
+    }
+    for (param = f->child[2]->child[0]; isStmt(param, ParamK); param = param->sibling)
+    {
+        newTemp(c);
+        if (param->type == IntArray)
+            newTemp(c);
+    }
+    for (param = f->child[2]->child[0]; isStmt(param, ParamK); param = param->sibling, arg = arg->sibling)
+    {
+        r = base + param->slot;
+        if (param->type != IntArray)
+        {
+            compileExp(c, arg, r);
+            continue;
+        }
+        decl = arg->decl;
+        if (isStmt(decl, ParamK))
+        {
+            emit(c, arg, OP_MOVE, r, decl->slot, 0, 0);
+            emit(c, arg, OP_MOVE, r + 1, decl->slot + 1, 0, 0);
+            continue;
+        }
+        if (isLocal(decl))
+            emit(c, arg, OP_ADDR, r, decl->slot, 0, 0);
+        else
+            emit(c, arg, OP_KONST, r, GLOBAL_SLOT(decl->slot), 0, 0);
+        emit(c, arg, OP_KONST, r + 1, arrayLength(decl), 0, 0);
+    }
+    emit(c, t, OP_CALL, dst, funcSlot(c, f)->index, base, 0);
+    c->top = mark;
+}
+
+/* compileExp puts the value of t in dst */
+static void compileExp(Compiler *c, TreeNode *t, int dst)
+{
+    int r;
+    if (t->nodekind == StmtK) /* an assignment inside an expression */
+    {
+        r = compileAssign(c, t);
+        if (r != dst)
+            emit(c, t, OP_MOVE, dst, r, 0, 0);
+        return;
+    }
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        emit(c, t, OP_KONST, dst, t->attr.val, 0, 0);
+        break;
+    case IdK:
+        if (!isLocal(t->decl))
+            emit(c, t, OP_GETG, dst, GLOBAL_SLOT(t->decl->slot), 0, 0);
+        else if (t->decl->slot != dst)
+            emit(c, t, OP_MOVE, dst, t->decl->slot, 0, 0);
+        break;
+    case Arry_ElemK:
+        compileElement(c, t, dst, -1);
+        break;
+    case CallK:
+        compileCall(c, t, dst);
+        break;
+    case OpK:
+        compileOp(c, t, dst);
+        break;
+    default:
+        break;
+    }
+}
+
+/* compileAssign compiles the AssignK t and returns
+   the register left holding the value assigned */
+static int compileAssign(Compiler *c, TreeNode *t)
+{
+    TreeNode *var = t->child[0];
+    const TreeNode *decl = var->decl;
+    int i, v;
+    if (isExp(var, IdK) && isLocal(decl))
+    {
+        compileExp(c, t->child[1], decl->slot);
+        return decl->slot;
+    }
+    if (isExp(var, IdK))
+    {
+        v = operand(c, t->child[1]);
+        emit(c, t, OP_SETG, GLOBAL_SLOT(decl->slot), v, 0, 0);
+        return v;
+    }
+    /* the index is checked before the value is taken,
+       as interp does, by reading the element */
+    i = operand(c, var->child[1]);
+    if (!isPure(t->child[1]))
+        compileElement(c, var, newTemp(c), i);
+    v = operand(c, t->child[1]);
+    if (isStmt(decl, ParamK))
+        emit(c, var, OP_SETP, decl->slot, i, v, 0);
+    else if (isLocal(decl))
+        emit(c, var, OP_SETL, decl->slot, i, arrayLength(decl), v);
+    else
+        emit(c, var, OP_SETGA, GLOBAL_SLOT(decl->slot), i, arrayLength(decl), v);
+    return v;
+}
+
+/**************************************************/
+/* statements                                     */
+/**************************************************/
+
+/* negate gives the jump taken when a relop is false */
+static OpCode negate(OpCode jump)
+{
+    switch (jump)
+    {
+    case OP_JLT:
+        return OP_JGE;
+    case OP_JLE:
+        return OP_JGT;
+    case OP_JGT:
+        return OP_JLE;
+    case OP_JGE:
+        return OP_JLT;
+    case OP_JEQ:
+        return OP_JNE;
+    default:
+        return OP_JEQ;
+    }
+}
+
+/* compileJump compiles a jump taken when the
+   condition t is as wanted, and returns its offset
+   for patch */
+static int compileJump(Compiler *c, TreeNode *t, int wanted)
+{
+    int mark = c->top, a, at;
+    OpCode jump;
+    TreeNode *r;
+    if (isExp(t, OpK) && rOp(t->attr.op) >= OP_LT)
+    {
+        jump = OP_JLT + (rOp(t->attr.op) - OP_LT);
+        if (!wanted)
+            jump = negate(jump);
+        a = operand(c, t->child[0]);
+        r = t->child[1];
+        if (isExp(r, ConstK))
+            at = emit(c, t, jump + (OP_JLTK - OP_JLT), a, r->attr.val, 0, 0);
+        else
+            at = emit(c, t, jump, a, operand(c, r), 0, 0);
+    }
+    else
+        at = emit(c, t, wanted ? OP_JNZ : OP_JZ, operand(c, t), 0, 0, 0);
+    c->top = mark;
+    return at;
+}
+
+static void compileStmt(Compiler *c, TreeNode *t)
+{
+    int mark = c->top, at, end;
+    if (t == NULL)
+        return;
+    if (t->nodekind == ExpK)
+    {
+        if (isExp(t, CallK))
+            compileCall(c, t, newTemp(c));
+        else
+            operand(c, t);
+        c->top = mark;
+        return;
+    }
+    switch (t->kind.stmt)
+    {
+    case IfK:
+        at = compileJump(c, t->child[0], FALSE);
+        compileStmt(c, t->child[1]);
+        if (t->child[2] != NULL)
+        {
+            end = emit(c, t, OP_JMP, 0, 0, 0, 0);
+            patch(c, at, c->bc->count);
+            compileStmt(c, t->child[2]);
+            at = end;
+        }
+        patch(c, at, c->bc->count);
+        break;
+    case WhileK:
+        /* the test goes at the bottom: one jump a turn */
+        at = emit(c, t, OP_JMP, 0, 0, 0, 0);
+        end = c->bc->count;
+        compileStmt(c, t->child[1]);
+        patch(c, at, c->bc->count);
+        patch(c, compileJump(c, t->child[0], TRUE), end);
+        break;
+    case ReturnK:
+        if (t->child[0] != NULL)
+            emit(c, t, OP_RET, operand(c, t->child[0]), 0, 0, 0);
+        else
+            emit(c, t, OP_RET0, 0, 0, 0, 0);
+        break;
+    case AssignK:
+        compileAssign(c, t);
+        break;
+    case CompK:
+        for (t = t->child[0]; t != NULL; t = t->sibling)
+            compileStmt(c, t);
+        break;
+    default:
+        break;
+    }
+    c->top = mark;
+}
+
+/**************************************************/
+/* programs                                       */
+/**************************************************/
+
+/* a program to compile and how it went */
+typedef struct
+{
+    TreeNode *tree;
+    Bytecode *bc;
+    int result;
+} Compilation;
+
+/* compileMain compiles the program on the compiler's
+   own thread, which has room for deep expressions */
+static void *compileMain(void *arg)
+{
+    Compilation *job = arg;
+    TreeNode *tree = job->tree, *t;
+    Bytecode *bc = job->bc;
+    Compiler c;
+    int start, len;
+    memset(bc, 0, sizeof(*bc));
+    memset(&c, 0, sizeof(c));
+    c.bc = bc;
+    /* the program calls main, whose frame is the first
+       on the stack, and halts; -1 if there is no main */
+    start = emit(&c, NULL, OP_CALL, 0, -1, 0, 0);
+    emit(&c, tree, OP_HALT, 0, 0, 0, 0);
+    for (t = tree; t != NULL && !c.failed; t = t->sibling)
+        if (isStmt(t, FuncK))
+        {
+            compileFunc(&c, t);
+            if (strcmp(t->child[1]->attr.name, "main") == 0 && !c.failed)
+            {
+                bc->code[start + 2] = bc->funcCount - 1;
+                bc->where[start] = t;
+            }
+        }
+        else if (isStmt(t, Var_DeclK))
+        {
+            len = t->type == IntArray ? arrayLength(t) : 1;
+            bc->globals = GLOBAL_SLOT(t->slot) + len;
+        }
+    free(c.funcs);
+    if (c.failed)
+        freeBytecode(bc);
+    job->result = c.failed ? -1 : 0;
+    return NULL;
+}
+
+/* Function compileProgram compiles an analyzed syntax
+ * tree without errors into bc; 0, or -1 if memory is
+ * exhausted
+ */
+int compileProgram(TreeNode *tree, Bytecode *bc)
+{
+    Compilation job;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int started;
+    job.tree = tree;
+    job.bc = bc;
+    job.result = -1;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, COMPILE_THREAD_STACK);
+    started = pthread_create(&thread, &attr, compileMain, &job) == 0;
+    pthread_attr_destroy(&attr);
+    if (started)
+        pthread_join(thread, NULL);
+    else
+        compileMain(&job);
+    return job.result;
+}
+
+/* Procedure freeBytecode releases compiled code */
+void freeBytecode(Bytecode *bc)
+{
+    free(bc->code);
+    free(bc->where);
+    free(bc->funcs);
+    memset(bc, 0, sizeof(*bc));
+}
+
+/* Procedure disassemble lists the code of each
+ * function to f, one instruction a line
+ */
+void disassemble(const Bytecode *bc, FILE *f)
+{
+    int pc = 0, fn = 0, i;
+    const char *kinds;
+    fprintf(f, "%d words of globals, %d functions, %d ints of code\n", bc->globals, bc->funcCount, bc->count);
+    while (pc < bc->count)
+    {
+        if (fn < bc->funcCount && bc->funcs[fn].entry == pc)
+        {
+            const VmFunc *v = &bc->funcs[fn++];
+            fprintf(f, "\n%s: %d params, frame of %d words, %d registers\n", v->name, v->params, v->frame,
+                    v->regs);
+        }
+        kinds = opOperands[bc->code[pc]];
+        fprintf(f, kinds[0] != '\0' ? "  %05d  %-6s" : "  %05d  %s", pc, opName[bc->code[pc]]);
+        for (i = 0; kinds[i] != '\0'; i++)
+        {
+            int x = bc->code[pc + 1 + i];
+            fprintf(f, i > 0 ? ", " : " ");
+            switch (kinds[i])
+            {
+            case 'r':
+                fprintf(f, "r%d", x);
+                break;
+            case 'g':
+                fprintf(f, "@%d", x);
+                break;
+            case 'j':
+                fprintf(f, "-> %05d", pc + x);
+                break;
+            case 'f':
+                fprintf(f, "%s", x >= 0 ? bc->funcs[x].name : "?");
+                break;
+            default:
+                fprintf(f, "%d", x);
+            }
+        }
+        fprintf(f, "\n");
+        pc += 1 + opArgs[bc->code[pc]];
+    }
+}
@@ -0,0 +1,218 @@
+#include "globals.h"
+#include "walk.h"
+#include "fold.h"
+
+#include <limits.h>
+
+/* what the walk knows of the nodes below a depth */
+typedef struct
+{
+    int impure; /* one of them calls, assigns or may fail */
+    int nodes;  /* how many there are */
+} Below;
+
+/* the state of one fold */
+typedef struct
+{
+    Below *below; /* below[d] sums up the children of the node open at depth d - 1 */
+    int cap;
+    int removed;
+} Folder;
+
+/* Function foldOp computes x op y for an arithmetic or
+ * relational op as a C- program does at run time
+ */
+int foldOp(TokenType op, int x, int y, int *val)
+{
+    switch (op)
+    {
+    case PLUS:
+        *val = (int)((unsigned)x + (unsigned)y);
+        break;
+    case MINUS:
+        *val = (int)((unsigned)x - (unsigned)y);
+        break;
+    case TIMES:
+        *val = (int)((unsigned)x * (unsigned)y);
+        break;
+    case OVER:
+        if (y == 0 || (x == INT_MIN && y == -1))
+            return FALSE;
+        *val = x / y;
+        break;
+    case LT:
+        *val = x < y;
+        break;
+    case LE:
+        *val = x <= y;
+        break;
+    case GT:
+        *val = x > y;
+        break;
+    case GE:
+        *val = x >= y;
+        break;
+    case EQ:
+        *val = x == y;
+        break;
+    case NEQ:
+        *val = x != y;
+        break;
+    default:
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static int isConst(const TreeNode *t, int val)
+{
+    return t->nodekind == ExpK && t->kind.exp == ConstK && t->attr.val == val;
+}
+
+static int isAnyConst(const TreeNode *t)
+{
+    return t->nodekind == ExpK && t->kind.exp == ConstK;
+}
+
+/* makeConst turns t into the ConstK of val */
+static void makeConst(TreeNode *t, int val)
+{
+    int i;
+    for (i = 0; i < MAXCHILDREN; i++)
+        t->child[i] = NULL;
+    t->kind.exp = ConstK;
+    t->attr.val = val;
+    t->type = Integer;
+}
+
+/* replaceBy puts operand x in the place of t, which
+   keeps its siblings */
+static void replaceBy(TreeNode *t, const TreeNode *x)
+{
+    TreeNode *sibling = t->sibling;
+    *t = *x;
+    t->sibling = sibling;
+}
+
+/* foldNode simplifies the OpK t, whose operands are
+   already folded, and returns how many nodes it took
+   out of the size nodes under and including t */
+static int foldNode(TreeNode *t, int impure, int size)
+{
+    TreeNode *l = t->child[0], *r = t->child[1];
+    int val;
+    if (l == NULL || r == NULL)
+        return 0;
+    if (isAnyConst(l) && isAnyConst(r))
+    {
+        if (!foldOp(t->attr.op, l->attr.val, r->attr.val, &val))
+            return 0;
+        makeConst(t, val);
+        return 2;
+    }
+    switch (t->attr.op)
+    {
+    case PLUS:
+        if (isConst(r, 0))
+            break;
+        if (isConst(l, 0))
+        {
+            replaceBy(t, r);
+            return 2;
+        }
+        return 0;
+    case MINUS:
+    case OVER:
+        if (isConst(r, t->attr.op == OVER))
+            break;
+        return 0;
+    case TIMES:
+        if ((isConst(l, 0) || isConst(r, 0)) && !impure)
+        {
+            makeConst(t, 0);
+            return size - 1;
+        }
+        if (isConst(r, 1))
+            break;
+        if (isConst(l, 1))
+        {
+            replaceBy(t, r);
+            return 2;
+        }
+        return 0;
+    default:
+        return 0;
+    }
+    replaceBy(t, l);
+    return 2;
+}
+
+/* mayFail tells whether evaluating t alone, its
+   operands aside, can stop the program: an index out
+   of bounds, or a divisor that is not a constant other
+   than 0 and -1 */
+static int mayFail(const TreeNode *t)
+{
+    const TreeNode *r = t->child[1];
+    if (t->nodekind != ExpK)
+        return FALSE;
+    if (t->kind.exp == Arry_ElemK)
+        return TRUE;
+    return t->kind.exp == OpK && t->attr.op == OVER &&
+           (r == NULL || !isAnyConst(r) || r->attr.val == 0 || r->attr.val == -1);
+}
+
+/* enter makes room to sum up the children of t */
+static int enter(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Folder *f = arg;
+    if (pos->depth + 2 > f->cap)
+    {
+        int cap = f->cap * 2;
+        Below *grown = realloc(f->below, cap * sizeof(Below));
+        if (grown == NULL)
+            return WALK_STOP;
+        f->below = grown;
+        f->cap = cap;
+    }
+    f->below[pos->depth + 1].impure = FALSE;
+    f->below[pos->depth + 1].nodes = 0;
+    return WALK_CONTINUE;
+}
+
+/* leave folds an OpK once its operands are done, and
+   adds t up into its parent's summary */
+static int leave(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Folder *f = arg;
+    const Below *kids = &f->below[pos->depth + 1];
+    Below *here = &f->below[pos->depth];
+    int impure = kids->impure, size = 1 + kids->nodes, removed = 0;
+    if (t->nodekind == ExpK && t->kind.exp == OpK)
+        removed = foldNode(t, impure, size);
+    f->removed += removed;
+    here->impure = here->impure || impure || (t->nodekind == ExpK && t->kind.exp == CallK) ||
+                   (t->nodekind == StmtK && t->kind.stmt == AssignK) || mayFail(t);
+    here->nodes += size - removed;
+    return WALK_CONTINUE;
+}
+
+/* Function foldTree simplifies the OpK expressions of
+ * an analyzed syntax tree in place and returns how
+ * many nodes it eliminated, or -1
+ */
+int foldTree(TreeNode *tree)
+{
+    Folder f;
+    int result;
+    f.cap = 64;
+    f.removed = 0;
+    f.below = malloc(f.cap * sizeof(Below));
+    if (f.below == NULL)
+        return -1;
+    f.below[0].impure = FALSE;
+    f.below[0].nodes = 0;
+    result = walkTree(tree, enter, leave, &f);
+    free(f.below);
+    return result == 0 ? f.removed : -1;
+}
@@ -0,0 +1,27 @@
+#ifndef _FOLD_H_
+#define _FOLD_H_
+
+/* Function foldTree simplifies the OpK expressions of
+ * an analyzed syntax tree without semantic errors in
+ * place, bottom up in one walk, and returns how many
+ * nodes it eliminated, or -1 if memory is exhausted.
+ * An OpK whose operands are both ConstK becomes the
+ * ConstK of its value; x+0, 0+x, x-0, x*1, 1*x and x/1
+ * become x; and x*0 and 0*x become 0 unless x calls a
+ * function, assigns, indexes an array or divides by
+ * anything but a constant other than 0 and -1, any of
+ * which may stop the program. Division by zero, and the
+ * one quotient that overflows, are left for run time.
+ * The nodes left out stay in the arena.
+ */
+int foldTree(TreeNode *);
+
+/* Function foldOp computes x op y for an arithmetic or
+ * relational op as a C- program does at run time, with
+ * int arithmetic wrapping around and comparisons giving
+ * 1 or 0; FALSE, leaving *val alone, if op is not one
+ * of those or the quotient is undefined
+ */
+int foldOp(TokenType op, int x, int y, int *val);
+
+#endif
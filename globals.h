@@ -6,6 +6,10 @@
 #include <ctype.h>
 #include <string.h>
 
+#include "arena.h"
+#include "intern.h"
+#include "outbuf.h"
+
 #ifndef FALSE
 #define FALSE 0
 #endif
@@ -14,8 +18,17 @@
 #define TRUE 1
 #endif
 
+/* PARSER_VERSION must be bumped whenever the listing
+ * or syntax tree produced for some input changes, so
+ * that cached results of older parsers are ignored
+ */
+#define PARSER_VERSION 6
+
 #define MAXRESERVED 6
 
+/* MAXTOKENLEN is the maximum size of a token */
+#define MAXTOKENLEN 40
+
 typedef enum
 {
     /* book-keeping tokens */
@@ -54,6 +67,43 @@ typedef enum
 
 } TokenType;
 
+/* A Token records one token of the source text: its
+ * type, where its lexeme lies (an offset from the
+ * parser's spanBase and a length, so no lexeme is
+ * copied or cut short) and the line it is on. An ID
+ * also carries its interned name.
+ */
+typedef struct
+{
+    TokenType type;
+    int offset;
+    int length;
+    int lineno;
+    const char *name; /* interned lexeme of an ID, else NULL */
+} Token;
+
+/* LOOKAHEAD is the size of the parser's token ring:
+ * the current token and up to LOOKAHEAD - 1 tokens
+ * peeked at after it; a power of 2
+ */
+#define LOOKAHEAD 4
+
+/* A TokenArray holds all the tokens of a source text,
+ * scanned before parsing starts, as a struct of
+ * arrays: entry i of each array describes token i
+ * as a Token would. The last token is ENDFILE.
+ */
+typedef struct
+{
+    unsigned char *types; /* TokenType of each token */
+    int *offsets;
+    int *lengths;
+    int *lines;
+    const char **names; /* interned names of IDs, else NULL */
+    int count;
+    int cap;
+} TokenArray;
+
 extern FILE *source;  /* source code text file */
 extern FILE *listing; /* listing output text file */
 
@@ -89,12 +139,34 @@ typedef enum
     ArgsK,
 } ExpKind;
 
+/* ExpType is used for type checking */
+typedef enum
+{
+    Void,
+    Integer,
+    IntArray
+} ExpType;
+
+/* the slot of a global at address a; it maps a
+   global's slot back to its address too */
+#define GLOBAL_SLOT(a) (-1 - (a))
+#define IS_GLOBAL_SLOT(s) ((s) < 0)
+
+/* the number of StmtKinds and ExpKinds */
+#define STMTKINDS (CompK + 1)
+#define EXPKINDS (ArgsK + 1)
+
 #define MAXCHILDREN 4
 typedef struct treeNode
 {
     struct treeNode *child[MAXCHILDREN];
     struct treeNode *sibling;
     int lineno;
+    /* byte offsets of the first char and one past the
+       last char of the node's tokens in the source;
+       kept for declarations and compound statements
+       (see incr.h), -1 elsewhere */
+    int start, end;
     NodeKind nodekind;
     union
     {
@@ -105,10 +177,112 @@ typedef struct treeNode
     {
         TokenType op;
         int val;
-        char *name;
+        char *name; /* interned: equal names share one pointer */
     } attr;
+    /* for an IdK, CallK or Arry_ElemK use of a name, the
+       Var_DeclK, ParamK or FuncK declaring it, once the
+       tree is analyzed (see analyze.h); else NULL */
+    struct treeNode *decl;
+    /* once analyzed, the type of an expression, or
+       the type declared by a Var_DeclK, ParamK or
+       FuncK (its return type); else Void */
+    ExpType type;
+    /* once analyzed, where a Var_DeclK or ParamK keeps
+       its value: an offset in its function's frame, or
+       for a global, GLOBAL_SLOT of its address; for a
+       FuncK, the words of its frame; for a CompK, the
+       frame offset of its first local (see interp.h) */
+    int slot;
 } TreeNode;
 
+/* A ReuseSet lists subtrees of an earlier parse that
+ * a reparse may splice in unchanged instead of parsing
+ * them again, once it reaches their first token at
+ * their new offset (see incr.h). Both lists are in
+ * source order; offsets are those of the old source.
+ */
+typedef struct
+{
+    TreeNode **decls; /* top-level declarations after the edit */
+    int declCount, nextDecl;
+    TreeNode **comps; /* compound statements outside the edit */
+    int compCount, nextComp;
+    int editStart, editEnd; /* old offsets of the replaced text */
+    int shift;              /* new offset - old offset past the edit */
+    int lineShift;          /* new lineno - old lineno past the edit */
+    int resumed;            /* parsing starts after kept declarations */
+    int failed;             /* a reused subtree could not be moved */
+} ReuseSet;
+
+/* ParseStats counts the work of a parser for --stats
+ * (see stats.h); a parser only counts while its stats
+ * pointer is set
+ */
+typedef struct
+{
+    long tokens;               /* tokens read by the parser */
+    long stmtNodes[STMTKINDS]; /* nodes allocated, by StmtKind */
+    long expNodes[EXPKINDS];   /* and by ExpKind */
+} ParseStats;
+
+/* A CMinusParser holds all the state of one parse:
+ * the source buffer and scanner position, the current
+ * token, and the arena and name table the syntax tree
+ * is built in. Parsers share nothing, so separate
+ * files can be parsed concurrently. The global API
+ * (getToken, parse, printTree with source, listing
+ * and lineno) works on one default parser.
+ * Listing text goes through out and reaches listing
+ * when parseWith or printTreeWith returns, or on
+ * flushListing.
+ */
+typedef struct
+{
+    FILE *source;  /* source code text file */
+    FILE *listing; /* listing output text file */
+    int lineno;    /* source line number for listing */
+
+    /* scanner state */
+    const char *srcBuf;  /* start of the source text */
+    const char *srcEnd;  /* one past the last source char */
+    const char *srcPos;  /* next char to be scanned */
+    const char *lineEnd; /* one past the end of the current line */
+    const char *textEnd; /* end of the text lines are echoed from */
+    char *srcAlloc;      /* srcBuf when malloc'd, else NULL */
+    size_t srcMapped;    /* bytes mapped at srcBuf, else 0 */
+    int EOF_flag;        /* corrects ungetNextChar behavior on EOF */
+    char tokenString[MAXTOKENLEN + 1];
+    const char *tokenName; /* interned lexeme of the last ID */
+    const char *spanBase;   /* node spans are offsets from here */
+    const char *tokenStart; /* first char of the last token */
+    const char *tokenEnd;   /* one past the last token */
+
+    /* token stream: the current token is tokens[tokenHead],
+       and the tokenCount - 1 after it have been peeked at */
+    Token tokens[LOOKAHEAD];
+    int tokenHead;
+    int tokenCount;
+    const char *prevEnd; /* one past the token before the current one */
+    const TokenArray *tokenArray; /* tokens read instead of scanning, or NULL */
+    int tokenIndex;               /* next token to read from tokenArray */
+
+    /* parser state */
+    TokenType token; /* holds current token */
+    int errorCount;  /* syntax errors reported so far */
+    ReuseSet *reuse; /* old subtrees to splice in, or NULL */
+    ParseStats *stats; /* counters to update, or NULL */
+
+    /* syntax tree storage and printing */
+    Arena arena;
+    InternTable names;
+    int indentno;
+    OutBuf out; /* listing text not yet written */
+
+    /* tracing flags, copied from the globals below */
+    int echoSource;
+    int traceScan;
+} CMinusParser;
+
 /**************************************************/
 /***********   Flags for tracing       ************/
 /**************************************************/
@@ -131,4 +305,11 @@ extern int TraceScan;
  */
 extern int TraceParse;
 
+/* FoldConstants = TRUE causes the constant
+ * subexpressions of a tree without errors to be
+ * folded after it is analyzed (see fold.h), so the
+ * AST file and later passes get the smaller tree
+ */
+extern int FoldConstants;
+
 #endif
\ No newline at end of file
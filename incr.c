@@ -0,0 +1,195 @@
+#include "globals.h"
+#include "scan.h"
+#include "parse.h"
+#include "incr.h"
+#include "walk.h"
+
+/* Function applyEdit returns a new NUL-terminated
+ * copy of the len chars at text with edit applied,
+ * storing its length in newLen; NULL if the edit does
+ * not fit the text or memory is exhausted
+ */
+char *applyEdit(const char *text, int len, const TextEdit *edit, int *newLen)
+{
+    char *t;
+    int tail;
+    if (edit->offset < 0 || edit->removed < 0 || edit->length < 0 ||
+        edit->offset > len || edit->removed > len - edit->offset)
+        return NULL;
+    tail = len - edit->offset - edit->removed;
+    *newLen = edit->offset + edit->length + tail;
+    t = malloc(*newLen + 1);
+    if (t == NULL)
+        return NULL;
+    if (edit->offset > 0)
+        memcpy(t, text, edit->offset);
+    if (edit->length > 0)
+        memcpy(t + edit->offset, edit->text, edit->length);
+    if (tail > 0)
+        memcpy(t + edit->offset + edit->length, text + edit->offset + edit->removed, tail);
+    t[*newLen] = '\0';
+    return t;
+}
+
+static int countLines(const char *from, const char *to)
+{
+    int n = 0;
+    while ((from = memchr(from, '\n', to - from)) != NULL)
+    {
+        n++;
+        from++;
+    }
+    return n;
+}
+
+/* a growable list of subtrees */
+typedef struct
+{
+    TreeNode **nodes;
+    int count, cap;
+} NodeList;
+
+static int addNode(NodeList *list, TreeNode *t)
+{
+    if (list->count == list->cap)
+    {
+        int cap = list->cap ? list->cap * 2 : 64;
+        TreeNode **grown = realloc(list->nodes, cap * sizeof(TreeNode *));
+        if (grown == NULL)
+            return FALSE;
+        list->nodes = grown;
+        list->cap = cap;
+    }
+    list->nodes[list->count++] = t;
+    return TRUE;
+}
+
+/* the compound statements being collected and the
+   edit they must lie outside of */
+typedef struct
+{
+    NodeList *list;
+    const ReuseSet *r;
+} Collector;
+
+/* collectCompound adds t to the list if it is a
+   compound statement wholly before or wholly after
+   the edit */
+static int collectCompound(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    Collector *c = arg;
+    if (t->nodekind == StmtK && t->kind.stmt == CompK && t->start >= 0 &&
+        (t->end <= c->r->editStart || t->start >= c->r->editEnd) && !addNode(c->list, t))
+        return WALK_STOP;
+    return WALK_CONTINUE;
+}
+
+/* collectCompounds adds every compound statement in
+   the sibling chain t, and below it, that lies wholly
+   before or wholly after the edit */
+static int collectCompounds(NodeList *list, TreeNode *t, const ReuseSet *r)
+{
+    Collector c;
+    c.list = list;
+    c.r = r;
+    return walkTree(t, collectCompound, NULL, &c) == 0;
+}
+
+static int byStart(const void *a, const void *b)
+{
+    const TreeNode *x = *(TreeNode *const *)a, *y = *(TreeNode *const *)b;
+    return (x->start > y->start) - (x->start < y->start);
+}
+
+/* parseFrom parses text from offset restart on, with
+   the reuse set r (or NULL), and returns the new
+   declarations */
+static TreeNode *parseFrom(CMinusParser *ps, const char *text, int len, int restart, ReuseSet *r)
+{
+    const char *end = text + len;
+    int echoSource = ps->echoSource, traceScan = ps->traceScan;
+    int lineno = 1 + countLines(text, text + restart);
+    TreeNode *t;
+    closeSource(ps);
+    setSourceText(ps, text + restart, end, end, lineno, restart > 0 && text[restart - 1] != '\n');
+    ps->spanBase = text;
+    ps->errorCount = 0;
+    ps->echoSource = ps->traceScan = FALSE;
+    ps->reuse = r;
+    t = parseWith(ps);
+    ps->reuse = NULL;
+    ps->echoSource = echoSource;
+    ps->traceScan = traceScan;
+    return t;
+}
+
+/* Function reparseWith returns the syntax tree of
+ * newText, the source text after edit, given tree,
+ * the last tree the parser built from oldText
+ */
+TreeNode *reparseWith(CMinusParser *ps, TreeNode *tree, const char *oldText,
+                      const TextEdit *edit, const char *newText, int newLen)
+{
+    ReuseSet r;
+    NodeList decls = {NULL, 0, 0}, comps = {NULL, 0, 0};
+    TreeNode *kept = NULL, *t, *rest;
+    int restart = 0, ok = TRUE;
+
+    if (tree == NULL || oldText == NULL || ps->errorCount > 0 || tree->start < 0)
+        return parseFrom(ps, newText, newLen, 0, NULL);
+
+    memset(&r, 0, sizeof(r));
+    r.editStart = edit->offset;
+    r.editEnd = edit->offset + edit->removed;
+    r.shift = edit->length - edit->removed;
+    r.lineShift = countLines(edit->text, edit->text + edit->length) -
+                  countLines(oldText + r.editStart, oldText + r.editEnd);
+
+    /* declarations ending ahead of the edit are kept;
+       the last one is always parsed again so that the
+       parse has at least one declaration to start on */
+    for (t = tree; t->sibling != NULL && t->end <= r.editStart; t = t->sibling)
+        kept = t;
+    if (kept != NULL)
+        restart = kept->end;
+    /* the ones after the edit are candidates to resume
+       at, and compound statements outside the edit
+       candidates to skip; those are only looked for up
+       to the first declaration after the edit, since the
+       parse resumes at the declarations from there on */
+    for (; ok && t != NULL; t = t->sibling)
+    {
+        TreeNode *next = t->sibling;
+        if (t->start >= r.editEnd)
+            ok = addNode(&decls, t);
+        if (decls.count <= 1)
+        {
+            t->sibling = NULL;
+            ok = ok && collectCompounds(&comps, t, &r);
+            t->sibling = next;
+        }
+    }
+    if (!ok)
+    {
+        free(decls.nodes);
+        free(comps.nodes);
+        return parseFrom(ps, newText, newLen, 0, NULL);
+    }
+    if (comps.count > 1)
+        qsort(comps.nodes, comps.count, sizeof(TreeNode *), byStart);
+    r.decls = decls.nodes;
+    r.declCount = decls.count;
+    r.comps = comps.nodes;
+    r.compCount = comps.count;
+    r.resumed = kept != NULL;
+
+    rest = parseFrom(ps, newText, newLen, restart, &r);
+    free(decls.nodes);
+    free(comps.nodes);
+    if (r.failed)
+        return parseFrom(ps, newText, newLen, 0, NULL);
+    if (kept == NULL)
+        return rest;
+    kept->sibling = rest;
+    return tree;
+}
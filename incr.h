@@ -0,0 +1,47 @@
+#ifndef _INCR_H_
+#define _INCR_H_
+
+/* A TextEdit replaces the removed chars at offset in
+ * a source text by the length chars at text
+ */
+typedef struct
+{
+    int offset;
+    int removed;
+    const char *text;
+    int length;
+} TextEdit;
+
+/* Function applyEdit returns a new NUL-terminated
+ * copy of the len chars at text with edit applied,
+ * storing its length in newLen; NULL if the edit does
+ * not fit the text or memory is exhausted
+ */
+char *applyEdit(const char *text, int len, const TextEdit *edit, int *newLen);
+
+/* Function reparseWith returns the syntax tree of
+ * newText, the source text after edit, given tree,
+ * the last tree the parser built from oldText (either
+ * NULL to parse newText from scratch).
+ *
+ * Top-level declarations and compound statements of
+ * tree whose spans lie outside the edit are spliced
+ * into the new tree instead of being parsed again:
+ * those ahead of the edit are kept as they are, and
+ * the parse picks up the rest as soon as it reaches
+ * the first token of one of them at its new offset.
+ * Only the text in between is scanned. Reused nodes
+ * are updated in place, so tree must not be used
+ * afterwards; nodes it no longer needs stay in the
+ * parser's arena until freeTreesWith.
+ *
+ * newText is scanned in place and must stay valid
+ * until the parser reads another source. When tree
+ * had syntax errors the whole text is parsed again,
+ * so errors are always reported in full. Source echo
+ * and token tracing are off during a reparse.
+ */
+TreeNode *reparseWith(CMinusParser *, TreeNode *tree, const char *oldText,
+                      const TextEdit *edit, const char *newText, int newLen);
+
+#endif
@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+
+#define MINCAPACITY 1024
+
+/* FNV-1a over the raw chars */
+static unsigned hashChars(const char *s, int len)
+{
+    unsigned h = 2166136261u;
+    int i;
+    for (i = 0; i < len; i++)
+    {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* grow doubles the table, rehashing from the stored
+   hashes; returns FALSE if memory is exhausted */
+static int grow(InternTable *table)
+{
+    unsigned capacity = table->capacity ? table->capacity * 2 : MINCAPACITY;
+    InternSlot *slots = calloc(capacity, sizeof(InternSlot));
+    unsigned i;
+    if (slots == NULL)
+        return 0;
+    for (i = 0; i < table->capacity; i++)
+    {
+        InternSlot *old = &table->slots[i];
+        unsigned j;
+        if (old->str == NULL)
+            continue;
+        for (j = old->hash & (capacity - 1); slots[j].str != NULL; j = (j + 1) & (capacity - 1))
+            ;
+        slots[j] = *old;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+    return 1;
+}
+
+/* Function internString returns the shared copy of
+ * the len chars at s, making one in arena the first
+ * time they are seen; NULL if memory is exhausted
+ */
+const char *internString(InternTable *table, Arena *arena, const char *s, int len)
+{
+    unsigned h = hashChars(s, len);
+    unsigned i;
+    char *copy;
+    /* keep the load factor at or below one half */
+    if (2 * (table->count + 1) > table->capacity && !grow(table))
+        return NULL;
+    for (i = h & (table->capacity - 1); table->slots[i].str != NULL; i = (i + 1) & (table->capacity - 1))
+    {
+        InternSlot *slot = &table->slots[i];
+        if (slot->hash == h && slot->len == len && !memcmp(slot->str, s, len))
+            return slot->str;
+    }
+    copy = arenaAlloc(arena, len + 1);
+    if (copy == NULL)
+        return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    table->slots[i].str = copy;
+    table->slots[i].hash = h;
+    table->slots[i].len = len;
+    table->count++;
+    return copy;
+}
+
+/* Procedure clearInternTable forgets every string
+ * and releases the table's own memory
+ */
+void clearInternTable(InternTable *table)
+{
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
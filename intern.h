@@ -0,0 +1,39 @@
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include "arena.h"
+
+/* An InternTable keeps one shared copy of every
+ * distinct string handed to it, so interned strings
+ * can be compared by pointer. It is an open-addressing
+ * hash table; the copies live in the arena given to
+ * internString and the table must be cleared whenever
+ * that arena is freed. A zero-initialized table is
+ * empty and ready to use.
+ */
+typedef struct
+{
+    const char *str;
+    unsigned hash;
+    int len;
+} InternSlot;
+
+typedef struct
+{
+    InternSlot *slots;
+    unsigned capacity; /* a power of two, or 0 */
+    unsigned count;
+} InternTable;
+
+/* Function internString returns the shared copy of
+ * the len chars at s, making one in arena the first
+ * time they are seen; NULL if memory is exhausted
+ */
+const char *internString(InternTable *, Arena *, const char *s, int len);
+
+/* Procedure clearInternTable forgets every string
+ * and releases the table's own memory
+ */
+void clearInternTable(InternTable *);
+
+#endif
@@ -0,0 +1,327 @@
+#include "globals.h"
+#include "fold.h"
+#include "interp.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+
+/* C stack for the thread running a program: calls
+   nest in the interpreter as they do in the program */
+#define INTERP_THREAD_STACK (256L << 20)
+
+/* how a statement ends */
+#define EXEC_NEXT 0   /* go on to the next one */
+#define EXEC_RETURN 1 /* its function returns */
+#define EXEC_FAIL 2   /* a runtime error stopped the program */
+
+/* the state of a running program */
+typedef struct
+{
+    TreeNode *tree;
+    FILE *in, *out;
+    int *mem;
+    int memSize;
+    int sp;     /* first free word of the stack */
+    int fp;     /* frame of the running function */
+    int calls;  /* calls in progress */
+    int retval; /* value of the last return */
+    int failed;
+} Interp;
+
+static int eval(Interp *ip, TreeNode *t);
+static int exec(Interp *ip, TreeNode *t);
+
+/* runtimeError reports an error at t and stops the
+   program */
+static void runtimeError(Interp *ip, const TreeNode *t, const char *format, ...)
+{
+    va_list args;
+    fprintf(stderr, "Runtime error at line %d: ", t->lineno);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    ip->failed = TRUE;
+}
+
+/* address returns the word of the variable decl in
+   the running frame */
+static int address(const Interp *ip, const TreeNode *decl)
+{
+    return IS_GLOBAL_SLOT(decl->slot) ? GLOBAL_SLOT(decl->slot) : ip->fp + decl->slot;
+}
+
+static const char *declName(const TreeNode *decl)
+{
+    const TreeNode *id = decl->child[1];
+    return id->kind.exp == Arry_DeclK ? id->child[0]->attr.name : id->attr.name;
+}
+
+/* arrayOf returns the address of the array declared
+   by decl, storing its length in len */
+static int arrayOf(const Interp *ip, const TreeNode *decl, int *len)
+{
+    int a = address(ip, decl);
+    if (decl->kind.stmt == ParamK)
+    {
+        *len = ip->mem[a + 1];
+        return ip->mem[a];
+    }
+    *len = decl->child[1]->child[1]->attr.val;
+    return a;
+}
+
+/* element returns the word of the Arry_ElemK t, or -1
+   after an error */
+static int element(Interp *ip, TreeNode *t)
+{
+    int len, base = arrayOf(ip, t->decl, &len);
+    int i = eval(ip, t->child[1]);
+    if (ip->failed)
+        return -1;
+    if (i < 0 || i >= len)
+    {
+        runtimeError(ip, t, "index %d out of bounds of %s[%d]", i, declName(t->decl), len);
+        return -1;
+    }
+    return base + i;
+}
+
+/* assign runs the AssignK t and returns the value
+   assigned */
+static int assign(Interp *ip, TreeNode *t)
+{
+    TreeNode *var = t->child[0];
+    int a = var->kind.exp == Arry_ElemK ? element(ip, var) : address(ip, var->decl);
+    int val;
+    if (ip->failed)
+        return 0;
+    val = eval(ip, t->child[1]);
+    if (ip->failed)
+        return 0;
+    ip->mem[a] = val;
+    return val;
+}
+
+/* builtin runs a call of input or output */
+static int builtin(Interp *ip, TreeNode *call, const TreeNode *f, TreeNode *arg)
+{
+    int val;
+    if (f->type == Integer)
+    {
+        if (fscanf(ip->in, "%d", &val) != 1)
+        {
+            runtimeError(ip, call, "no int left to input");
+            return 0;
+        }
+        return val;
+    }
+    val = eval(ip, arg);
+    if (!ip->failed)
+        fprintf(ip->out, "%d\n", val);
+    return 0;
+}
+
+/* call runs the CallK t and returns the value its
+   function returns, 0 for a void one */
+static int call(Interp *ip, TreeNode *t)
+{
+    TreeNode *f = t->decl, *params, *arg = t->child[1] != NULL ? t->child[1]->child[0] : NULL;
+    int frame = ip->sp, savedFp = ip->fp, status, len;
+    if (f->child[3] == NULL) /* a built-in has no body */
+        return builtin(ip, t, f, arg);
+    if (ip->calls == INTERP_MAX_CALLS)
+    {
+        runtimeError(ip, t, "calls nested more than %d deep", INTERP_MAX_CALLS);
+        return 0;
+    }
+    if (f->slot > ip->memSize - frame)
+    {
+        runtimeError(ip, t, "out of stack memory");
+        return 0;
+    }
+    /* calls among the arguments get frames above this one */
+    memset(ip->mem + frame, 0, f->slot * sizeof(int));
+    ip->sp = frame + f->slot;
+    params = f->child[2]->child[0];
+    for (; params != NULL && params->kind.stmt == ParamK; params = params->sibling, arg = arg->sibling)
+        if (params->type == IntArray)
+        {
+            ip->mem[frame + params->slot] = arrayOf(ip, arg->decl, &len);
+            ip->mem[frame + params->slot + 1] = len;
+        }
+        else
+        {
+            ip->mem[frame + params->slot] = eval(ip, arg);
+            if (ip->failed)
+            {
+                ip->sp = frame;
+                return 0;
+            }
+        }
+    ip->fp = frame;
+    ip->calls++;
+    status = exec(ip, f->child[3]);
+    ip->calls--;
+    ip->fp = savedFp;
+    ip->sp = frame;
+    return status == EXEC_RETURN && f->type == Integer ? ip->retval : 0;
+}
+
+/* eval returns the value of the expression t; after an
+   error the value is 0 and ip->failed is set */
+static int eval(Interp *ip, TreeNode *t)
+{
+    int x, y, val;
+    if (t->nodekind == StmtK) /* an assignment inside an expression */
+        return assign(ip, t);
+    switch (t->kind.exp)
+    {
+    case ConstK:
+        return t->attr.val;
+    case IdK:
+        return ip->mem[address(ip, t->decl)];
+    case Arry_ElemK:
+        x = element(ip, t);
+        return x >= 0 ? ip->mem[x] : 0;
+    case CallK:
+        return call(ip, t);
+    case OpK:
+        x = eval(ip, t->child[0]);
+        if (ip->failed)
+            return 0;
+        y = eval(ip, t->child[1]);
+        if (ip->failed)
+            return 0;
+        if (foldOp(t->attr.op, x, y, &val))
+            return val;
+        runtimeError(ip, t, y == 0 ? "division by zero" : "division overflow");
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/* execList runs the statements of a chain in turn */
+static int execList(Interp *ip, TreeNode *t)
+{
+    int status = EXEC_NEXT;
+    for (; t != NULL && status == EXEC_NEXT; t = t->sibling)
+        status = exec(ip, t);
+    return status;
+}
+
+/* exec runs the statement t; NULL is the empty
+   statement */
+static int exec(Interp *ip, TreeNode *t)
+{
+    int status;
+    if (t == NULL)
+        return EXEC_NEXT;
+    if (t->nodekind == ExpK)
+    {
+        eval(ip, t);
+        return ip->failed ? EXEC_FAIL : EXEC_NEXT;
+    }
+    switch (t->kind.stmt)
+    {
+    case IfK:
+        if (eval(ip, t->child[0]))
+            return ip->failed ? EXEC_FAIL : exec(ip, t->child[1]);
+        if (ip->failed)
+            return EXEC_FAIL;
+        return t->child[2] != NULL ? exec(ip, t->child[2]) : EXEC_NEXT;
+    case WhileK:
+        while (eval(ip, t->child[0]) && !ip->failed)
+            if ((status = exec(ip, t->child[1])) != EXEC_NEXT)
+                return status;
+        return ip->failed ? EXEC_FAIL : EXEC_NEXT;
+    case ReturnK:
+        if (t->child[0] != NULL)
+            ip->retval = eval(ip, t->child[0]);
+        return ip->failed ? EXEC_FAIL : EXEC_RETURN;
+    case AssignK:
+        assign(ip, t);
+        return ip->failed ? EXEC_FAIL : EXEC_NEXT;
+    case CompK:
+        return execList(ip, t->child[0]);
+    default:
+        return EXEC_NEXT;
+    }
+}
+
+/* globalWords returns the words of global memory the
+   top-level declarations of tree take */
+static int globalWords(const TreeNode *tree)
+{
+    int words = 0, len;
+    for (; tree != NULL; tree = tree->sibling)
+        if (tree->kind.stmt == Var_DeclK)
+        {
+            len = tree->type == IntArray ? tree->child[1]->child[1]->attr.val : 1;
+            words = GLOBAL_SLOT(tree->slot) + len;
+        }
+    return words;
+}
+
+/* runMain runs the program on the interpreter's own
+   thread, which has room for deep recursion */
+static void *runMain(void *arg)
+{
+    Interp *ip = arg;
+    TreeNode *t, *mainFunc = NULL;
+    for (t = ip->tree; t != NULL; t = t->sibling)
+        if (t->kind.stmt == FuncK && strcmp(t->child[1]->attr.name, "main") == 0)
+            mainFunc = t;
+    if (mainFunc == NULL)
+    {
+        fprintf(stderr, "Runtime error: no main function\n");
+        ip->failed = TRUE;
+        return NULL;
+    }
+    ip->sp = ip->memSize - INTERP_STACK_WORDS;
+    ip->fp = ip->sp;
+    if (mainFunc->slot > INTERP_STACK_WORDS)
+    {
+        runtimeError(ip, mainFunc, "out of stack memory");
+        return NULL;
+    }
+    memset(ip->mem + ip->sp, 0, mainFunc->slot * sizeof(int));
+    ip->sp += mainFunc->slot;
+    exec(ip, mainFunc->child[3]);
+    return NULL;
+}
+
+/* Function runProgram calls main in an analyzed
+ * syntax tree without errors; 0 when it returns, 1
+ * after a runtime error
+ */
+int runProgram(TreeNode *tree, FILE *in, FILE *out)
+{
+    Interp ip;
+    pthread_attr_t attr;
+    pthread_t thread;
+    int globals = globalWords(tree), started;
+    memset(&ip, 0, sizeof(ip));
+    ip.tree = tree;
+    ip.in = in;
+    ip.out = out;
+    ip.memSize = globals + INTERP_STACK_WORDS;
+    ip.mem = calloc(ip.memSize, sizeof(int));
+    if (ip.mem == NULL)
+    {
+        fprintf(stderr, "Out of memory error running program\n");
+        return 1;
+    }
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, INTERP_THREAD_STACK);
+    started = pthread_create(&thread, &attr, runMain, &ip) == 0;
+    pthread_attr_destroy(&attr);
+    if (started)
+        pthread_join(thread, NULL);
+    else
+        runMain(&ip);
+    fflush(out);
+    free(ip.mem);
+    return ip.failed;
+}
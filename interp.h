@@ -0,0 +1,30 @@
+#ifndef _INTERP_H_
+#define _INTERP_H_
+
+/* The interpreter runs a C- program straight from its
+ * syntax tree, once analyze has found no errors in it:
+ * every use of a name already points at its declaration
+ * and every variable has its slot (see analyze.h), so
+ * no name is looked up while the program runs. Memory
+ * is one array of int words, the globals from address
+ * 0 followed by a stack of frames; an array passed to
+ * a function is its address and length. Arithmetic
+ * wraps around as in foldOp (see fold.h).
+ */
+
+/* the words of stack memory, and the deepest nesting
+   of calls a program may reach */
+#define INTERP_STACK_WORDS (4 << 20)
+#define INTERP_MAX_CALLS 100000
+
+/* Function runProgram calls main in an analyzed
+ * syntax tree without errors, with input reading ints
+ * from in and output writing them to out, one per
+ * line. It returns 0 when main returns, or 1 after a
+ * runtime error (no main, dividing by zero, an index
+ * out of bounds, running out of input, stack or call
+ * depth), which is reported to stderr with its line
+ */
+int runProgram(TreeNode *, FILE *in, FILE *out);
+
+#endif
@@ -2,6 +2,18 @@
 #include "scan.h"
 #include "parse.h"
 #include "util.h"
+#include "batch.h"
+#include "pparse.h"
+#include "ast.h"
+#include "astfile.h"
+#include "cache.h"
+#include "stats.h"
+#include "analyze.h"
+#include "fold.h"
+#include "interp.h"
+#include "vm.h"
+
+#include <time.h>
 
 /* allocate global variables */
 int lineno = 0;
@@ -13,17 +25,168 @@ int EchoSource = FALSE;
 int TraceScan = FALSE;
 int TraceParse = TRUE;
 
+/* allocate and set optimization flags */
+int FoldConstants = FALSE;
+
+static void usage(char *prog)
+{
+    fprintf(stderr, "usage: %s [--parallel | --pretokenize] [-j <threads>] [--ast <astfile>] [<cache options>] [--fold] [--run | --vm] [--disasm] [--stats | --stats-json] <filename>\n", prog);
+    fprintf(stderr, "       %s --batch [--pretokenize] [-j <threads>] [--fold] [<cache options>] [<filename> ...]\n", prog);
+    fprintf(stderr, "       %s --print-ast <astfile>\n", prog);
+    fprintf(stderr, "       %s --cache-stats <dir>\n", prog);
+    fprintf(stderr, "cache options: --cache <dir> [--cache-size <MB>]\n");
+    exit(1);
+}
+
+static double nowMillis(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* parseTokenized parses the source in two passes,
+   scanning it all into a token array first, and
+   reports the time each pass took to report */
+static TreeNode *parseTokenized(RunStats *stats, FILE *report)
+{
+    CMinusParser *ps = defaultParser();
+    TokenArray tokens;
+    TreeNode *t = NULL;
+    double start = nowMillis(), scanned;
+    /* the scan pass would write echo and trace output
+       ahead of the parser's messages */
+    if (EchoSource || TraceScan)
+    {
+        startPhase(stats, ParsePhase);
+        t = parse();
+        endPhase(stats);
+        return t;
+    }
+    startPhase(stats, ScanPhase);
+    if (tokenizeWith(ps, &tokens) < 0)
+    {
+        endPhase(stats);
+        fprintf(stderr, "Out of memory error\n");
+    }
+    else
+    {
+        endPhase(stats);
+        scanned = nowMillis();
+        startPhase(stats, ParsePhase);
+        t = parseTokensWith(ps, &tokens);
+        endPhase(stats);
+        if (stats == NULL)
+            fprintf(report, "scan %.3f ms (%d tokens), parse %.3f ms\n",
+                   scanned - start, tokens.count, nowMillis() - scanned);
+    }
+    freeTokenArray(&tokens);
+    lineno = ps->lineno;
+    return t;
+}
+
+/* printAstFile prints the tree in a binary AST file
+   to the screen as TraceParse would */
+static int printAstFile(char *path)
+{
+    AstFile *ast = openAstFile(path);
+    if (ast == NULL)
+    {
+        fprintf(stderr, "%s is not a readable AST file\n", path);
+        return 1;
+    }
+    listing = stdout;
+    printTree(fromAstFile(defaultParser(), ast));
+    closeAstFile(ast);
+    freeTrees();
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
 
     char pgm[120]; /* source code file name */
     char out[120]; /* output file name */
-    if (argc != 2)
+    int batch = FALSE;    /* --batch: parse many files on a thread pool */
+    int parallel = FALSE; /* --parallel: parse declarations in parallel */
+    int pretokenize = FALSE; /* --pretokenize: scan everything, then parse */
+    int threads = 0;      /* -j: thread count, 0 for one per core */
+    char *astOut = NULL;  /* --ast: binary AST file to write */
+    char *astIn = NULL;   /* --print-ast: binary AST file to print */
+    char *cacheDir = NULL; /* --cache: directory of cached results */
+    long long cacheBytes = 0; /* --cache-size: its size bound */
+    Cache *cache = NULL;
+    RunStats runStats;    /* --stats: what the run did */
+    RunStats *stats = NULL;
+    int statsJson = FALSE; /* --stats-json: report it as JSON */
+    CacheKey key = 0;
+    CompactAst *ast = NULL;
+    size_t srcLen = 0;
+    int vm = FALSE;       /* --vm: run it compiled to bytecode */
+    int disasm = FALSE;   /* --disasm: list the bytecode */
+    Bytecode bc;
+    int errors, semanticErrors = 0, folded = 0, run = FALSE, failed = FALSE, i;
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
     {
-        fprintf(stderr, "usage: %s <filename>\n", argv[0]);
-        exit(1);
+        if (strcmp(argv[i], "--batch") == 0)
+            batch = TRUE;
+        else if (strcmp(argv[i], "--parallel") == 0)
+            parallel = TRUE;
+        else if (strcmp(argv[i], "--pretokenize") == 0)
+            pretokenize = TRUE;
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--ast") == 0 && i + 1 < argc)
+            astOut = argv[++i];
+        else if (strcmp(argv[i], "--print-ast") == 0 && i + 1 < argc)
+            astIn = argv[++i];
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+            cacheDir = argv[++i];
+        else if (strcmp(argv[i], "--cache-size") == 0 && i + 1 < argc)
+            cacheBytes = atoll(argv[++i]) * 1024 * 1024;
+        else if (strcmp(argv[i], "--cache-stats") == 0 && i + 1 < argc)
+            return printCacheStats(argv[++i]);
+        else if (strcmp(argv[i], "--fold") == 0)
+            FoldConstants = TRUE;
+        else if (strcmp(argv[i], "--run") == 0)
+            run = TRUE;
+        else if (strcmp(argv[i], "--vm") == 0)
+            run = vm = TRUE;
+        else if (strcmp(argv[i], "--disasm") == 0)
+            disasm = TRUE;
+        else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats-json") == 0)
+        {
+            stats = &runStats;
+            statsJson = argv[i][7] != '\0';
+        }
+        else
+            usage(argv[0]);
+    }
+    if (cacheDir != NULL)
+    {
+        cache = openCache(cacheDir, cacheBytes);
+        if (cache == NULL)
+            fprintf(stderr, "Cannot use cache directory %s\n", cacheDir);
+    }
+    if ((stats != NULL || run || disasm) && (batch || astIn != NULL))
+        usage(argv[0]);
+    if (batch)
+    {
+        int failed = runBatch(argv + i, argc - i, threads, pretokenize, cache);
+        if (cache != NULL)
+            closeCache(cache);
+        return failed != 0;
+    }
+    if (astIn != NULL)
+        return printAstFile(astIn);
+    if (argc - i != 1 || (parallel && pretokenize))
+        usage(argv[0]);
+    strcpy(pgm, argv[i]);
+    if (stats != NULL)
+    {
+        memset(stats, 0, sizeof(*stats));
+        stats->name = pgm;
     }
-    strcpy(pgm, argv[1]);
     if (strchr(pgm, '.') == NULL)
         strcat(pgm, ".c-");
     source = fopen(pgm, "r");
@@ -36,7 +199,44 @@ int main(int argc, char *argv[])
     /* send listing to screen */
     // listing = stdout;
     /* send listing to file */
-    listing = fopen(strcat(strtok(argv[1], "."), ".txt"), "w");
+    strcpy(out, strcat(strtok(argv[i], "."), ".txt"));
+    listing = fopen(out, "w");
+    if (stats != NULL)
+        defaultParser()->stats = &stats->counts;
+
+    /* an unchanged file is answered from the cache, unless
+       it is to be run or its listing is to have bytecode */
+    if (cache != NULL || stats != NULL)
+    {
+        const char *text;
+        startPhase(stats, ReadPhase);
+        text = sourceText(defaultParser(), &srcLen);
+        endPhase(stats);
+        if (stats != NULL)
+            stats->sourceBytes = srcLen;
+        if (cache != NULL)
+            key = cacheKey(text, srcLen);
+    }
+    if (cache != NULL && !run && !disasm)
+    {
+        startPhase(stats, WritePhase);
+        if (cacheFetch(cache, key, srcLen, listing, astOut, &errors, &semanticErrors))
+        {
+            closeCache(cache);
+            fclose(source);
+            fclose(listing);
+            endPhase(stats);
+            if (stats != NULL)
+            {
+                stats->cached = TRUE;
+                stats->errors = errors;
+                stats->semanticErrors = semanticErrors;
+                printStats(stats, stdout, statsJson);
+            }
+            return 0;
+        }
+        endPhase(stats);
+    }
 
     // Scan
     /* fprintf(listing, "CMINUS COMPILATION:\n");
@@ -46,14 +246,104 @@ int main(int argc, char *argv[])
 
     // Parse
     fprintf(listing, "CMINUS PARSING:\n");
-    TreeNode *syntaxTree = parse();
+    TreeNode *syntaxTree;
+    if (pretokenize)
+        syntaxTree = parseTokenized(stats, run ? stderr : stdout); /* stdout is the program's */
+    else
+    {
+        startPhase(stats, ParsePhase);
+        if (parallel)
+            syntaxTree = parseParallelWith(defaultParser(), threads);
+        else
+            syntaxTree = parse();
+        endPhase(stats);
+    }
     if (TraceParse)
     {
+        startPhase(stats, PrintPhase);
         fprintf(listing, "\nSyntax tree:\n");
         printTree(syntaxTree);
+        endPhase(stats);
+    }
+    if (defaultParser()->errorCount == 0)
+    {
+        startPhase(stats, AnalyzePhase);
+        semanticErrors = analyze(syntaxTree);
+        endPhase(stats);
     }
+    if (FoldConstants && defaultParser()->errorCount == 0 && semanticErrors == 0)
+    {
+        startPhase(stats, FoldPhase);
+        folded = foldTree(syntaxTree);
+        endPhase(stats);
+        if (folded < 0)
+            fprintf(listing, "Out of memory error folding constants\n");
+        else
+            fprintf(listing, "\nConstant folding eliminated %d nodes\n", folded);
+        if (folded > 0 && TraceParse)
+        {
+            fprintf(listing, "\nFolded syntax tree:\n");
+            printTree(syntaxTree);
+        }
+    }
+    if ((run || disasm) && (defaultParser()->errorCount > 0 || semanticErrors > 0))
+    {
+        fprintf(stderr, "%s has errors, see %s; not %s\n", pgm, out, run ? "run" : "compiled");
+        failed = TRUE;
+    }
+    else if (vm || disasm)
+    {
+        startPhase(stats, CompilePhase);
+        failed = compileProgram(syntaxTree, &bc) < 0;
+        endPhase(stats);
+        if (failed)
+            fprintf(stderr, "Out of memory error compiling %s\n", pgm);
+        else if (disasm)
+        {
+            fprintf(listing, "\nBytecode:\n");
+            disassemble(&bc, listing);
+        }
+        if (!failed && vm)
+        {
+            startPhase(stats, RunPhase);
+            failed = runBytecode(&bc, stdin, stdout);
+            endPhase(stats);
+        }
+        freeBytecode(&bc);
+    }
+    if (run && !vm && !failed)
+    {
+        startPhase(stats, RunPhase);
+        failed = runProgram(syntaxTree, stdin, stdout);
+        endPhase(stats);
+    }
+    startPhase(stats, WritePhase);
+    if (astOut != NULL || cache != NULL)
+        ast = toCompactAst(syntaxTree);
+    if (astOut != NULL && (ast == NULL || writeAstFile(ast, astOut) < 0))
+        fprintf(stderr, "Cannot write AST file %s\n", astOut);
+    errors = defaultParser()->errorCount;
 
-    fclose(source);
     fclose(listing);
-    return 0;
-}
\ No newline at end of file
+    if (cache != NULL)
+    {
+        if (!disasm)
+            cacheStore(cache, key, srcLen, out, ast, errors, semanticErrors);
+        closeCache(cache);
+    }
+    endPhase(stats);
+    if (stats != NULL)
+    {
+        stats->errors = errors;
+        stats->semanticErrors = semanticErrors;
+        stats->folded = folded;
+        stats->treeBytes = defaultParser()->arena.allocated;
+        stats->compactBytes = ast != NULL ? compactAstBytes(ast) : 0;
+        printStats(stats, run ? stderr : stdout, statsJson); /* stdout is the program's */
+    }
+    /* the compact tree shares the parser's names */
+    freeCompactAst(ast);
+    freeTrees();
+    fclose(source);
+    return failed;
+}
@@ -0,0 +1,164 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+
+#define OUTBUFSIZE (64 * 1024)
+
+/* indentation comes out of one run of spaces
+   instead of a call per space */
+#define SPACERUN 128
+static const char spaces[SPACERUN + 1] =
+    "                                                                "
+    "                                                                ";
+
+/* writeOut sends n chars at s to the file: with a
+   single write when it has a descriptor, through
+   stdio when it is a memory stream */
+static void writeOut(OutBuf *out, const char *s, size_t n)
+{
+    int fd;
+    if (n == 0 || out->file == NULL)
+        return;
+    fflush(out->file);
+    fd = fileno(out->file);
+    if (fd < 0)
+    {
+        fwrite(s, 1, n, out->file);
+        return;
+    }
+    while (n > 0)
+    {
+        ssize_t done = write(fd, s, n);
+        if (done <= 0)
+            return;
+        s += done;
+        n -= done;
+    }
+}
+
+/* Procedure outFlush hands everything buffered so
+ * far to the file
+ */
+void outFlush(OutBuf *out)
+{
+    writeOut(out, out->data, out->len);
+    out->len = 0;
+}
+
+/* Procedure outWrite appends the n chars at s */
+void outWrite(OutBuf *out, const char *s, size_t n)
+{
+    if (out->data == NULL)
+    {
+        out->data = malloc(OUTBUFSIZE);
+        out->len = 0;
+        if (out->data == NULL)
+        {
+            writeOut(out, s, n);
+            return;
+        }
+    }
+    if (OUTBUFSIZE - out->len < n)
+    {
+        outFlush(out);
+        /* too big to be worth copying */
+        if (n >= OUTBUFSIZE)
+        {
+            writeOut(out, s, n);
+            return;
+        }
+    }
+    memcpy(out->data + out->len, s, n);
+    out->len += n;
+}
+
+/* Procedure outStr appends the string s */
+void outStr(OutBuf *out, const char *s)
+{
+    outWrite(out, s, strlen(s));
+}
+
+/* Procedure outChar appends the char c */
+void outChar(OutBuf *out, char c)
+{
+    if (out->data != NULL && out->len < OUTBUFSIZE)
+        out->data[out->len++] = c;
+    else
+        outWrite(out, &c, 1);
+}
+
+/* Procedure outInt appends val in decimal, padded
+ * on the left with spaces to at least width chars
+ */
+void outInt(OutBuf *out, int val, int width)
+{
+    char digits[16];
+    char *p = digits + sizeof(digits);
+    unsigned u = val < 0 ? 0u - (unsigned)val : (unsigned)val;
+    int n;
+    do
+    {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u != 0);
+    if (val < 0)
+        *--p = '-';
+    n = digits + sizeof(digits) - p;
+    if (width > n)
+        outSpaces(out, width - n);
+    outWrite(out, p, n);
+}
+
+/* Procedure outSpaces appends n spaces */
+void outSpaces(OutBuf *out, int n)
+{
+    while (n > SPACERUN)
+    {
+        outWrite(out, spaces, SPACERUN);
+        n -= SPACERUN;
+    }
+    if (n > 0)
+        outWrite(out, spaces, n);
+}
+
+/* Procedure outPrintf appends printf-style text;
+ * for the rare messages that are not worth a
+ * dedicated call
+ */
+void outPrintf(OutBuf *out, const char *format, ...)
+{
+    char text[512];
+    va_list ap;
+    int n;
+    va_start(ap, format);
+    n = vsnprintf(text, sizeof(text), format, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if ((size_t)n < sizeof(text))
+        outWrite(out, text, n);
+    else
+    {
+        char *big = malloc(n + 1);
+        if (big == NULL)
+            return;
+        va_start(ap, format);
+        vsnprintf(big, n + 1, format, ap);
+        va_end(ap);
+        outWrite(out, big, n);
+        free(big);
+    }
+}
+
+/* Procedure freeOutBuf flushes the buffer and
+ * releases its memory
+ */
+void freeOutBuf(OutBuf *out)
+{
+    outFlush(out);
+    free(out->data);
+    out->data = NULL;
+}
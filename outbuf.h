@@ -0,0 +1,55 @@
+#ifndef _OUTBUF_H_
+#define _OUTBUF_H_
+
+#include <stdio.h>
+#include <stddef.h>
+
+/* An OutBuf collects listing text in a large buffer
+ * in front of a FILE and hands it to the system with
+ * one write per buffer. Anything already in the FILE's
+ * own buffer is flushed first, so text written straight
+ * to the FILE between two outFlush calls stays in
+ * order. The buffer is allocated on first use; a
+ * zero-initialized OutBuf with file set is ready.
+ */
+typedef struct
+{
+    FILE *file;
+    char *data; /* OUTBUFSIZE bytes, or NULL */
+    size_t len; /* bytes waiting in data */
+} OutBuf;
+
+/* Procedure outWrite appends the n chars at s */
+void outWrite(OutBuf *, const char *s, size_t n);
+
+/* Procedure outStr appends the string s */
+void outStr(OutBuf *, const char *s);
+
+/* Procedure outChar appends the char c */
+void outChar(OutBuf *, char c);
+
+/* Procedure outInt appends val in decimal, padded
+ * on the left with spaces to at least width chars
+ */
+void outInt(OutBuf *, int val, int width);
+
+/* Procedure outSpaces appends n spaces */
+void outSpaces(OutBuf *, int n);
+
+/* Procedure outPrintf appends printf-style text;
+ * for the rare messages that are not worth a
+ * dedicated call
+ */
+void outPrintf(OutBuf *, const char *format, ...);
+
+/* Procedure outFlush hands everything buffered so
+ * far to the file
+ */
+void outFlush(OutBuf *);
+
+/* Procedure freeOutBuf flushes the buffer and
+ * releases its memory
+ */
+void freeOutBuf(OutBuf *);
+
+#endif
@@ -2,95 +2,264 @@
 #include "util.h"
 #include "scan.h"
 #include "parse.h"
+#include "walk.h"
 
 static int varDeclOnly = 1;
 static int allDecl = 0;
 
-static TokenType token; /* holds current token */
-
 /* function prototypes for recursive calls */
-static TreeNode *program(void);
-static TreeNode *declaration(int);
-static void declaration_(TreeNode **, TreeNode *, TreeNode *, int);
-static TreeNode *type_specifier(void);
+static TreeNode *program(CMinusParser *ps);
+static TreeNode *declaration(CMinusParser *, int);
+static void declaration_(CMinusParser *, TreeNode **, TreeNode *, TreeNode *, int);
+static TreeNode *type_specifier(CMinusParser *ps);
+
+static TreeNode *param_list(CMinusParser *ps);
+static TreeNode *param_list1(CMinusParser *ps);
+static TreeNode *param_list2(CMinusParser *ps);
+static TreeNode *param(CMinusParser *ps);
+
+static TreeNode *stmt(CMinusParser *ps);
+static TreeNode *exp_stmt(CMinusParser *ps);
+static TreeNode *return_stmt(CMinusParser *ps);
+static TreeNode *selection_stmt(CMinusParser *ps);
+static TreeNode *iteration_stmt(CMinusParser *ps);
+static TreeNode *compound_stmt(CMinusParser *ps);
+
+static TreeNode *assign_stmt(CMinusParser *ps); // ?
+
+static TreeNode *exp(CMinusParser *ps);
+static TreeNode *simple_exp(CMinusParser *, TreeNode *);
+static TreeNode *factor(CMinusParser *ps);
+static void factor_(CMinusParser *, TreeNode **, TreeNode *);
+static TreeNode *args(CMinusParser *ps);
+
+/* lexeme returns the current token's lexeme, which
+   lies in the source text */
+#define lexeme(ps) ((ps)->spanBase + currentToken(ps)->offset)
+
+/* idName returns the shared copy of the current
+   token's lexeme for an IdK node; the scanner has
+   already interned it when the token is an ID */
+static char *idName(CMinusParser *ps)
+{
+    const Token *t = currentToken(ps);
+    if (t->type == ID)
+        return (char *)t->name;
+    return (char *)internNameWith(ps, lexeme(ps), t->length);
+}
 
-static TreeNode *param_list(void);
-static TreeNode *param_list1(void);
-static TreeNode *param_list2(void);
-static TreeNode *param(void);
+/* numValue returns the value of the current token's
+   digits, wrapping around on overflow */
+static int numValue(CMinusParser *ps)
+{
+    const char *s = lexeme(ps);
+    unsigned val = 0;
+    int i;
+    for (i = 0; i < currentToken(ps)->length && isdigit((unsigned char)s[i]); i++)
+        val = val * 10 + (s[i] - '0');
+    return (int)val;
+}
 
-static TreeNode *stmt(void);
-static TreeNode *exp_stmt(void);
-static TreeNode *return_stmt();
-static TreeNode *selection_stmt(void);
-static TreeNode *iteration_stmt(void);
-static TreeNode *compound_stmt(void);
+/* printCurrentToken prints the current token the way
+   the scanner traces it, its lexeme cut at MAXTOKENLEN */
+static void printCurrentToken(CMinusParser *ps)
+{
+    const Token *t = currentToken(ps);
+    char text[MAXTOKENLEN + 1];
+    int len = t->length < MAXTOKENLEN ? t->length : MAXTOKENLEN;
+    memcpy(text, lexeme(ps), len);
+    text[len] = '\0';
+    printTokenWith(ps, t->type, text);
+}
+
+static void syntaxError(CMinusParser *ps, char *message)
+{
+    outStr(&ps->out, "\n2019141460148王世杰\n>>> Syntax error at line ");
+    outInt(&ps->out, currentToken(ps)->lineno, 0);
+    outStr(&ps->out, ": ");
+    outStr(&ps->out, message);
+    ps->errorCount++;
+}
 
-static TreeNode *assign_stmt(void); // ?
+static void match(CMinusParser *ps, TokenType expected)
+{
+    if (ps->token == expected)
+        ps->token = nextTokenWith(ps);
+    else
+    {
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        outSpaces(&ps->out, 6);
+    }
+}
 
-static TreeNode *exp(void);
-static TreeNode *simple_exp(TreeNode *);
-static TreeNode *additive_exp(void);
-static TreeNode *term(void);
-static TreeNode *factor(void);
-static void factor_(TreeNode **, TreeNode *);
-static TreeNode *args(void);
+/* offsetOf returns the offset of a char in the
+   source, as kept in node spans */
+#define offsetOf(ps, p) ((int)((p) - (ps)->spanBase))
 
-static void syntaxError(char *message)
+/* countLines counts the line breaks in [from, to) */
+static int countLines(const char *from, const char *to)
 {
-    fprintf(listing, "\n2019141460148王世杰\n>>> ");
-    fprintf(listing, "Syntax error at line %d: %s", lineno, message);
-    // Error = TRUE;
+    int n = 0;
+    while ((from = memchr(from, '\n', to - from)) != NULL)
+    {
+        n++;
+        from++;
+    }
+    return n;
 }
 
-static void match(TokenType expected)
+/* shiftNode moves a node of a reused subtree by the
+   reuse set's shift and lineShift */
+static int shiftNode(TreeNode *t, const WalkPos *pos, void *arg)
 {
-    if (token == expected)
-        token = getToken();
-    else
+    ReuseSet *r = arg;
+    t->lineno += r->lineShift;
+    if (t->start >= 0)
     {
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        fprintf(listing, "      ");
+        t->start += r->shift;
+        t->end += r->shift;
     }
+    return WALK_CONTINUE;
+}
+
+/* shiftTree moves t, its siblings and everything below
+   them to their place in the edited source; a failure
+   is left in r for reparseWith to fall back on */
+static int shiftTree(ReuseSet *r, TreeNode *t)
+{
+    if (walkTree(t, shiftNode, NULL, r) < 0)
+    {
+        r->failed = TRUE;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* newStart returns the offset an old subtree starts
+   at in the edited source */
+static int newStart(ReuseSet *r, TreeNode *t)
+{
+    return t->start < r->editStart ? t->start : t->start + r->shift;
+}
+
+/* skipReused moves the scanner past the reused
+   subtree t, which starts at the current token, and
+   reads the token after it */
+static void skipReused(CMinusParser *ps, TreeNode *t)
+{
+    const char *end = ps->spanBase + t->end;
+    int lineno = currentToken(ps)->lineno + countLines(lexeme(ps), end);
+    seekSource(ps, end, lineno);
+    ps->token = nextTokenWith(ps);
+}
+
+/* reusedDecls returns the old top-level declarations
+   from the current token on, when the token is the
+   first of one of them; they are moved to their new
+   place and the scanner skipped past them */
+static TreeNode *reusedDecls(CMinusParser *ps)
+{
+    ReuseSet *r = ps->reuse;
+    int at = currentToken(ps)->offset;
+    TreeNode *t, *last;
+    if (ps->token == ENDFILE)
+        return NULL;
+    while (r->nextDecl < r->declCount && newStart(r, r->decls[r->nextDecl]) < at)
+        r->nextDecl++;
+    if (r->nextDecl == r->declCount || newStart(r, r->decls[r->nextDecl]) != at)
+        return NULL;
+    t = r->decls[r->nextDecl];
+    /* nothing after this point is looked up again */
+    r->nextDecl = r->declCount;
+    r->nextComp = r->compCount;
+    if (!shiftTree(r, t))
+        return NULL;
+    for (last = t; last->sibling != NULL; last = last->sibling)
+        ;
+    skipReused(ps, last);
+    return t;
+}
+
+/* reusedCompound returns the old compound statement
+   that starts at the current '{', moved to its new
+   place and with the scanner skipped past it; NULL if
+   there is none */
+static TreeNode *reusedCompound(CMinusParser *ps)
+{
+    ReuseSet *r = ps->reuse;
+    int at = currentToken(ps)->offset;
+    TreeNode *t;
+    if (ps->token != LBRACE)
+        return NULL;
+    while (r->nextComp < r->compCount && newStart(r, r->comps[r->nextComp]) < at)
+        r->nextComp++;
+    if (r->nextComp == r->compCount || newStart(r, r->comps[r->nextComp]) != at)
+        return NULL;
+    t = r->comps[r->nextComp++];
+    /* compound statements nested in t come next in the
+       list; they are reused along with it */
+    while (r->nextComp < r->compCount && r->comps[r->nextComp]->start < t->end)
+        r->nextComp++;
+    t->sibling = NULL;
+    if (t->start >= r->editEnd && !shiftTree(r, t))
+        return NULL;
+    skipReused(ps, t);
+    return t;
 }
 
 /* program ->  declaration  { declaration } */
-TreeNode *program(void)
+TreeNode *program(CMinusParser *ps)
 {
-    TreeNode *t = declaration(allDecl);
-    TreeNode *p = t;
-    while (token != ENDFILE)
+    TreeNode *t = NULL, *p = NULL, *q;
+    do
     {
-        TreeNode *q;
-        q = declaration(allDecl);
+        /* a reparse may resume after the declarations it
+           kept, with nothing left to parse */
+        if (ps->reuse != NULL && ps->reuse->resumed && ps->token == ENDFILE)
+            break;
+        q = ps->reuse != NULL ? reusedDecls(ps) : NULL;
+        if (q == NULL)
+        {
+            int start = currentToken(ps)->offset;
+            q = declaration(ps, allDecl);
+            if (q != NULL)
+            {
+                q->start = start;
+                q->end = offsetOf(ps, ps->prevEnd);
+            }
+        }
         if (q != NULL)
         {
-            p->sibling = q;
-            p = q;
+            if (t == NULL)
+                t = q;
+            else
+                p->sibling = q;
+            for (p = q; p->sibling != NULL; p = p->sibling)
+                ;
         }
-    }
+    } while (ps->token != ENDFILE);
     return t;
 }
 
 /*  type_specifier ->  int  |  void  */
-TreeNode *type_specifier(void)
+TreeNode *type_specifier(CMinusParser *ps)
 {
     TreeNode *t = NULL;
-    switch (token)
+    switch (ps->token)
     {
     case INT:
-        t = newExpNode(IntK);
-        match(INT);
+        t = newExpNodeWith(ps, IntK);
+        match(ps, INT);
         break;
     case VOID:
-        t = newExpNode(VoidK);
-        match(VOID);
+        t = newExpNodeWith(ps, VoidK);
+        match(ps, VOID);
         break;
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
     return t;
@@ -98,64 +267,64 @@ TreeNode *type_specifier(void)
 
 /* FuncK  or Var_DeclK */
 /* declaration ->  type_specifier  ID  declaration’ */
-TreeNode *declaration(int ifVarDecl)
+TreeNode *declaration(CMinusParser *ps, int ifVarDecl)
 {
     TreeNode *t = NULL;
-    TreeNode *tS = type_specifier();
-    TreeNode *idNode = newExpNode(IdK);
-    if (idNode != NULL && token == ID)
-        idNode->attr.name = copyString(tokenString);
-    match(ID);
+    TreeNode *tS = type_specifier(ps);
+    TreeNode *idNode = newExpNodeWith(ps, IdK);
+    if (idNode != NULL && ps->token == ID)
+        idNode->attr.name = idName(ps);
+    match(ps, ID);
 
-    declaration_(&t, tS, idNode, ifVarDecl);
+    declaration_(ps, &t, tS, idNode, ifVarDecl);
 
     return t;
 }
 
 /* declaration’ ->  ;  |  [ NUM ];  |  ( params )  compound_stmt  */
-void declaration_(TreeNode **t, TreeNode *tyS, TreeNode *idNode, int ifVarDecl)
+void declaration_(CMinusParser *ps, TreeNode **t, TreeNode *tyS, TreeNode *idNode, int ifVarDecl)
 {
-    switch (token)
+    switch (ps->token)
     {
     case SEMI:
-        (*t) = newStmtNode(Var_DeclK);
+        (*t) = newStmtNodeWith(ps, Var_DeclK);
         (*t)->child[0] = tyS;
         (*t)->child[1] = idNode;
-        match(SEMI);
+        match(ps, SEMI);
         break;
     case LBRACKET:
-        (*t) = newStmtNode(Var_DeclK);
+        (*t) = newStmtNodeWith(ps, Var_DeclK);
         (*t)->child[0] = tyS;
 
-        match(LBRACKET);
-        TreeNode *arrayDecl = newExpNode(Arry_DeclK);
+        match(ps, LBRACKET);
+        TreeNode *arrayDecl = newExpNodeWith(ps, Arry_DeclK);
         arrayDecl->child[0] = idNode;
-        TreeNode *constNode = newExpNode(ConstK);
-        if (constNode != NULL && token == NUM)
+        TreeNode *constNode = newExpNodeWith(ps, ConstK);
+        if (constNode != NULL && ps->token == NUM)
         {
-            constNode->attr.val = atoi(tokenString);
-            match(NUM);
+            constNode->attr.val = numValue(ps);
+            match(ps, NUM);
         }
         arrayDecl->child[1] = constNode;
         (*t)->child[1] = arrayDecl;
-        match(RBRACKET);
+        match(ps, RBRACKET);
 
-        match(SEMI);
+        match(ps, SEMI);
         break;
     case LPAREN:
         if (ifVarDecl)
         {
-            syntaxError("unexpected token -> ");
-            printToken(token, tokenString);
-            token = getToken();
+            syntaxError(ps, "unexpected token -> ");
+            printCurrentToken(ps);
+            ps->token = nextTokenWith(ps);
             break;
         }
-        (*t) = newStmtNode(FuncK);
-        match(LPAREN);
-        TreeNode *paramsNode = param_list();
+        (*t) = newStmtNodeWith(ps, FuncK);
+        match(ps, LPAREN);
+        TreeNode *paramsNode = param_list(ps);
 
-        match(RPAREN);
-        TreeNode *compNode = compound_stmt();
+        match(ps, RPAREN);
+        TreeNode *compNode = compound_stmt(ps);
         if (t != NULL && compNode != NULL && paramsNode != NULL)
         {
             (*t)->child[0] = tyS;
@@ -166,29 +335,29 @@ void declaration_(TreeNode **t, TreeNode *tyS, TreeNode *idNode, int ifVarDecl)
         break;
 
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
 }
 
 /* param_list -> param_list1  |  param_list2 */
-TreeNode *param_list()
+TreeNode *param_list(CMinusParser *ps)
 {
-    TreeNode *t = newStmtNode(ParamsK);
-    switch (token)
+    TreeNode *t = newStmtNodeWith(ps, ParamsK);
+    switch (ps->token)
     {
     case VOID:
-        t->child[0] = param_list1();
+        t->child[0] = param_list1(ps);
         break;
     case INT:
-        t->child[0] = param_list2();
+        t->child[0] = param_list2(ps);
         break;
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
 
@@ -196,34 +365,34 @@ TreeNode *param_list()
 }
 
 /* param_list1->  void  [ ID  [ [  ] ]  {  , param  } ] */
-TreeNode *param_list1()
+TreeNode *param_list1(CMinusParser *ps)
 {
     TreeNode *t = NULL;
-    TreeNode *voidNode = newExpNode(VoidK);
-    match(VOID);
-    if (token == ID)
+    TreeNode *voidNode = newExpNodeWith(ps, VoidK);
+    match(ps, VOID);
+    if (ps->token == ID)
     {
-        t = newStmtNode(ParamK);
+        t = newStmtNodeWith(ps, ParamK);
         if (t != NULL && voidNode != NULL)
             t->child[0] = voidNode;
-        TreeNode *idNode = newExpNode(IdK);
-        idNode->attr.name = copyString(tokenString);
+        TreeNode *idNode = newExpNodeWith(ps, IdK);
+        idNode->attr.name = idName(ps);
         if (idNode != NULL && t != NULL)
             t->child[1] = idNode;
-        match(ID);
-        if (token == LBRACKET)
+        match(ps, ID);
+        if (ps->token == LBRACKET)
         {
-            match(LBRACKET);
-            TreeNode *empty = newExpNode(IdK);
-            empty->attr.name = "";
+            match(ps, LBRACKET);
+            TreeNode *empty = newExpNodeWith(ps, IdK);
+            empty->attr.name = (char *)internNameWith(ps, "", 0);
             t->child[2] = empty;
-            match(RBRACKET);
+            match(ps, RBRACKET);
         }
         TreeNode *p = t;
-        while (token == COMMA)
+        while (ps->token == COMMA)
         {
-            match(COMMA);
-            TreeNode *q = param();
+            match(ps, COMMA);
+            TreeNode *q = param(ps);
             p->sibling = q;
             p = q;
         }
@@ -234,33 +403,33 @@ TreeNode *param_list1()
 }
 
 /* param_list2->  int  ID  [ [  ] ]  {  , param  } */
-TreeNode *param_list2()
+TreeNode *param_list2(CMinusParser *ps)
 {
-    TreeNode *t = newStmtNode(ParamK);
-    TreeNode *intNode = newExpNode(IntK);
+    TreeNode *t = newStmtNodeWith(ps, ParamK);
+    TreeNode *intNode = newExpNodeWith(ps, IntK);
     if (t != NULL && intNode != NULL)
         t->child[0] = intNode;
-    match(INT);
+    match(ps, INT);
 
-    TreeNode *idNode = newExpNode(IdK);
-    idNode->attr.name = copyString(tokenString);
+    TreeNode *idNode = newExpNodeWith(ps, IdK);
+    idNode->attr.name = idName(ps);
     if (idNode != NULL && t != NULL)
         t->child[1] = idNode;
-    match(ID);
+    match(ps, ID);
 
-    if (token == LBRACKET)
+    if (ps->token == LBRACKET)
     {
-        match(LBRACKET);
-        TreeNode *empty = newExpNode(IdK);
-        empty->attr.name = "";
+        match(ps, LBRACKET);
+        TreeNode *empty = newExpNodeWith(ps, IdK);
+        empty->attr.name = (char *)internNameWith(ps, "", 0);
         t->child[2] = empty;
-        match(RBRACKET);
+        match(ps, RBRACKET);
     }
     TreeNode *p = t;
-    while (token == COMMA)
+    while (ps->token == COMMA)
     {
-        match(COMMA);
-        TreeNode *q = param();
+        match(ps, COMMA);
+        TreeNode *q = param(ps);
         p->sibling = q;
         p = q;
     }
@@ -268,15 +437,15 @@ TreeNode *param_list2()
 }
 
 /* param ->  type_specifier ID  [ [  ] ] */
-TreeNode *param()
+TreeNode *param(CMinusParser *ps)
 {
-    TreeNode *t = newStmtNode(ParamK);
-    TreeNode *tyS = type_specifier();
-    TreeNode *idNode = newExpNode(IdK);
-    if (idNode != NULL && token == ID)
+    TreeNode *t = newStmtNodeWith(ps, ParamK);
+    TreeNode *tyS = type_specifier(ps);
+    TreeNode *idNode = newExpNodeWith(ps, IdK);
+    if (idNode != NULL && ps->token == ID)
     {
-        idNode->attr.name = copyString(tokenString);
-        match(ID);
+        idNode->attr.name = idName(ps);
+        match(ps, ID);
     }
 
     if (t != NULL && tyS != NULL && idNode != NULL)
@@ -285,13 +454,13 @@ TreeNode *param()
         t->child[1] = idNode;
     }
 
-    if (token == LBRACKET)
+    if (ps->token == LBRACKET)
     {
-        match(LBRACKET);
-        TreeNode *empty = newExpNode(IdK);
+        match(ps, LBRACKET);
+        TreeNode *empty = newExpNodeWith(ps, IdK);
         if (empty != NULL)
-            empty->attr.name = "";
-        match(RBRACKET);
+            empty->attr.name = (char *)internNameWith(ps, "", 0);
+        match(ps, RBRACKET);
         t->child[2] = empty;
     }
     return t;
@@ -299,34 +468,34 @@ TreeNode *param()
 
 /* statement -> expression_stmt  |  compound_stmt  |  selection_stmt  |
                    iteration_stmt  |  return_stmt */
-TreeNode *stmt(void)
+TreeNode *stmt(CMinusParser *ps)
 {
     TreeNode *t = NULL;
-    switch (token)
+    switch (ps->token)
     {
     case IF:
-        t = selection_stmt();
+        t = selection_stmt(ps);
         break;
     case WHILE:
-        t = iteration_stmt();
+        t = iteration_stmt(ps);
         break;
     case RETURN:
-        t = return_stmt();
+        t = return_stmt(ps);
         break;
     case ID:
     case LPAREN:
     case NUM:
     case SEMI:
-        t = exp_stmt();
+        t = exp_stmt(ps);
         break;
 
     case LBRACE:
-        t = compound_stmt();
+        t = compound_stmt(ps);
         break;
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
     return t;
@@ -334,38 +503,38 @@ TreeNode *stmt(void)
 /*
  * selection_stmt -> if ( expression ) statement [ else statement ]
  */
-TreeNode *selection_stmt(void)
+TreeNode *selection_stmt(CMinusParser *ps)
 {
-    TreeNode *t = newStmtNode(IfK);
-    match(IF);
-    match(LPAREN);
+    TreeNode *t = newStmtNodeWith(ps, IfK);
+    match(ps, IF);
+    match(ps, LPAREN);
     if (t != NULL)
-        t->child[0] = exp();
-    match(RPAREN);
+        t->child[0] = exp(ps);
+    match(ps, RPAREN);
     if (t != NULL)
-        t->child[1] = stmt();
-    if (token == ELSE)
+        t->child[1] = stmt(ps);
+    if (ps->token == ELSE)
     {
-        match(ELSE);
+        match(ps, ELSE);
         if (t != NULL)
-            t->child[2] = stmt();
+            t->child[2] = stmt(ps);
     }
     return t;
 }
 
 /* iteration_stmt -> while ( expression ) statement  */
-TreeNode *iteration_stmt(void)
+TreeNode *iteration_stmt(CMinusParser *ps)
 {
-    TreeNode *t = newStmtNode(WhileK);
-    match(WHILE);
-    match(LPAREN);
+    TreeNode *t = newStmtNodeWith(ps, WhileK);
+    match(ps, WHILE);
+    match(ps, LPAREN);
     if (t != NULL)
-        t->child[0] = exp();
-    match(RPAREN);
+        t->child[0] = exp(ps);
+    match(ps, RPAREN);
     TreeNode *stmtNode = NULL;
     if (t != NULL)
     {
-        stmtNode = stmt();
+        stmtNode = stmt(ps);
     }
     if (t != NULL && stmtNode != NULL)
         t->child[1] = stmtNode;
@@ -374,36 +543,36 @@ TreeNode *iteration_stmt(void)
 }
 
 /* return_stmt ->  return  [  expression  ]; */
-TreeNode *return_stmt(void)
+TreeNode *return_stmt(CMinusParser *ps)
 {
-    TreeNode *t = newStmtNode(ReturnK);
-    match(RETURN);
-    if (token == ID || token == LPAREN || token == NUM)
-        t->child[0] = exp();
+    TreeNode *t = newStmtNodeWith(ps, ReturnK);
+    match(ps, RETURN);
+    if (ps->token == ID || ps->token == LPAREN || ps->token == NUM)
+        t->child[0] = exp(ps);
 
-    match(SEMI);
+    match(ps, SEMI);
     return t;
 }
 
 /* expression_stmt -> expression ;  |  ; */
-TreeNode *exp_stmt(void)
+TreeNode *exp_stmt(CMinusParser *ps)
 {
     TreeNode *t = NULL;
-    switch (token)
+    switch (ps->token)
     {
     case ID:
     case LPAREN:
     case NUM:
-        t = exp();
-        match(SEMI);
+        t = exp(ps);
+        match(ps, SEMI);
         break;
     case SEMI:
-        match(SEMI);
+        match(ps, SEMI);
         break;
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
 
@@ -411,18 +580,22 @@ TreeNode *exp_stmt(void)
 }
 
 /* compound_stmt -> {  { var_declaration }  { statement }  } */
-TreeNode *compound_stmt()
+TreeNode *compound_stmt(CMinusParser *ps)
 {
-    TreeNode *t = newStmtNode(CompK);
-    match(LBRACE);
+    TreeNode *t;
+    int start = currentToken(ps)->offset;
+    if (ps->reuse != NULL && (t = reusedCompound(ps)) != NULL)
+        return t;
+    t = newStmtNodeWith(ps, CompK);
+    match(ps, LBRACE);
     TreeNode *p = t->child[0], *q = NULL;
-    while (token != RBRACE)
+    while (ps->token != RBRACE && ps->token != ENDFILE)
     {
-        switch (token)
+        switch (ps->token)
         {
         case VOID:
         case INT:
-            q = declaration(varDeclOnly);
+            q = declaration(ps, varDeclOnly);
             if (q != NULL)
             {
                 if (t->child[0] == NULL)
@@ -442,7 +615,7 @@ TreeNode *compound_stmt()
         case IF:
         case WHILE:
         case RETURN:
-            q = stmt();
+            q = stmt(ps);
             if (q != NULL)
             {
                 if (t->child[0] == NULL)
@@ -455,283 +628,196 @@ TreeNode *compound_stmt()
             }
             break;
         default:
-            syntaxError("unexpected token -> ");
-            printToken(token, tokenString);
-            token = getToken();
+            syntaxError(ps, "unexpected token -> ");
+            printCurrentToken(ps);
+            ps->token = nextTokenWith(ps);
             break;
         }
     }
 
-    match(RBRACE);
+    match(ps, RBRACE);
+    t->start = start;
+    t->end = offsetOf(ps, ps->prevEnd);
     return t;
 }
 
+/* binding strength of the binary operators; tokens
+   with none end an expression */
+static const unsigned char precedence[] = {
+    [LT] = 1, [LE] = 1, [GT] = 1, [GE] = 1, [EQ] = 1, [NEQ] = 1,
+    [PLUS] = 2, [MINUS] = 2,
+    [TIMES] = 3, [OVER] = 3,
+};
+#define RELOP_PREC 1
+#define MAX_PREC 3
+#define precOf(token) ((unsigned)(token) < sizeof(precedence) ? precedence[token] : 0)
+
 /* factor ->  ( expression )  |  ID  factor’  |  NUM */
 /* factor’ ->  [expression]  |  ( args )  |  ε */
-TreeNode *factor(void)
+TreeNode *factor(CMinusParser *ps)
 {
     TreeNode *t = NULL;
     TreeNode *idNode = NULL;
-    switch (token)
+    switch (ps->token)
     {
     case LPAREN:
-        match(LPAREN);
-        t = exp();
-        match(RPAREN);
+        match(ps, LPAREN);
+        t = exp(ps);
+        match(ps, RPAREN);
         break;
     case ID: /* Array_ElemK || CallK */
-        idNode = newExpNode(IdK);
+        idNode = newExpNodeWith(ps, IdK);
         if (idNode != NULL)
         {
-            idNode->attr.name = copyString(tokenString);
-            match(ID);
+            idNode->attr.name = idName(ps);
+            match(ps, ID);
         }
-        switch (token)
-        {
-        case TIMES:
-        case OVER:
-        case MINUS:
-        case PLUS:
-        case LE:
-        case LT:
-        case GT:
-        case GE:
-        case EQ:
-        case NEQ:
-        case SEMI:
-        case RPAREN:
-        case COMMA:
+        if (ps->token == LPAREN || ps->token == LBRACKET)
+            factor_(ps, &t, idNode);
+        else if (precOf(ps->token) > 0 || ps->token == SEMI || ps->token == RPAREN ||
+                 ps->token == COMMA || ps->token == RBRACKET)
             t = idNode;
-            break;
-        case LPAREN:
-        case LBRACKET:
-            factor_(&t, idNode);
-            break;
-        default:
-            syntaxError("unexpected token -> ");
-            printToken(token, tokenString);
-            token = getToken();
-            break;
+        else
+        {
+            syntaxError(ps, "unexpected token -> ");
+            printCurrentToken(ps);
+            ps->token = nextTokenWith(ps);
         }
         break;
 
     case NUM:
-        t = newExpNode(ConstK);
-        if (t != NULL && token == NUM)
-            t->attr.val = atoi(tokenString);
-        match(NUM);
+        t = newExpNodeWith(ps, ConstK);
+        if (t != NULL && ps->token == NUM)
+            t->attr.val = numValue(ps);
+        match(ps, NUM);
         break;
 
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
     return t;
 }
 
 /* factor’ ->  [expression]  |  ( args )  |  ε */
-void factor_(TreeNode **t, TreeNode *idNode)
+void factor_(CMinusParser *ps, TreeNode **t, TreeNode *idNode)
 {
-    switch (token)
+    switch (ps->token)
     {
     case LBRACKET:
-        match(LBRACKET);
-        (*t) = newExpNode(Arry_ElemK);
+        match(ps, LBRACKET);
+        (*t) = newExpNodeWith(ps, Arry_ElemK);
         (*t)->child[0] = idNode;
-        (*t)->child[1] = exp();
-        match(RBRACKET);
+        (*t)->child[1] = exp(ps);
+        match(ps, RBRACKET);
         break;
     case LPAREN:
-        match(LPAREN);
-        (*t) = newExpNode(CallK);
+        match(ps, LPAREN);
+        (*t) = newExpNodeWith(ps, CallK);
         (*t)->child[0] = idNode;
-        TreeNode *temp = args();
+        TreeNode *temp = args(ps);
         if (temp != NULL)
             (*t)->child[1] = temp;
-        match(RPAREN);
+        match(ps, RPAREN);
         break;
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
 }
 
 /* expression -> var = expression  |  simple_expression */
-TreeNode *exp(void)
+/* var -> ID  |  ID [ expression ] */
+/* an ID followed by = or [ starts a var, which the
+   token after it decides the role of; anything else
+   starts a simple_expression */
+TreeNode *exp(CMinusParser *ps)
 {
     TreeNode *t = NULL;
-    TreeNode *idNode = NULL;
-    TreeNode *expNode = NULL;
-    TreeNode *arrayElemNode = NULL;
-    TreeNode *numNode = NULL;
-    TreeNode *argsNode = NULL;
-    TreeNode *callNode = NULL;
-    switch (token)
+    TreeNode *var = NULL;
+    TokenType next;
+    if (ps->token == ID && ((next = peekTokenWith(ps, 1)) == ASSIGN || next == LBRACKET))
+    {
+        var = newExpNodeWith(ps, IdK);
+        var->attr.name = idName(ps);
+        match(ps, ID);
+        if (next == LBRACKET)
+            factor_(ps, &var, var);
+        if (ps->token != ASSIGN)
+            return simple_exp(ps, var);
+        t = newStmtNodeWith(ps, AssignK);
+        match(ps, ASSIGN);
+        t->child[0] = var;
+        t->child[1] = exp(ps);
+        return t;
+    }
+    switch (ps->token)
     {
     case ID:
-        idNode = newExpNode(IdK);
-        idNode->attr.name = copyString(tokenString);
-        match(ID);
-
-        if (token == LBRACKET)
-        {
-            arrayElemNode = newExpNode(Arry_ElemK);
-            match(LBRACKET);
-            arrayElemNode->child[0] = idNode;
-            expNode = exp();
-            arrayElemNode->child[1] = expNode;
-            match(RBRACKET);
-            if (token == ASSIGN)
-            {
-                t = newStmtNode(AssignK);
-                match(ASSIGN);
-                t->child[0] = arrayElemNode;
-                t->child[1] = exp();
-            }
-            else if (token == OVER || token == TIMES || token == MINUS || token == PLUS || relop(token) || token == SEMI || token == RPAREN || token == COMMA || token == RBRACKET)
-            {
-                t = simple_exp(arrayElemNode);
-            }
-        }
-        else if (token == LPAREN)
-        {
-            match(LPAREN);
-            argsNode = args();
-            match(RPAREN);
-            callNode = newExpNode(CallK);
-            callNode->child[0] = idNode;
-            if (argsNode != NULL)
-                callNode->child[1] = argsNode;
-            t = simple_exp(callNode);
-        }
-        else
-        {
-            if (token == ASSIGN)
-            {
-                t = newStmtNode(AssignK);
-                match(ASSIGN);
-                t->child[0] = idNode;
-                t->child[1] = exp();
-            }
-            else if (token == OVER || token == TIMES || token == MINUS || token == PLUS || relop(token) || token == SEMI || token == RPAREN || token == COMMA || token == RBRACKET)
-            {
-                t = simple_exp(idNode);
-            }
-        }
-        break;
     case LPAREN:
-        match(LPAREN);
-        expNode = exp();
-        match(RPAREN);
-        t = simple_exp(expNode);
-        break;
     case NUM:
-        numNode = newExpNode(ConstK);
-        if (numNode != NULL && token == NUM)
-            numNode->attr.val = atoi(tokenString);
-        match(NUM);
-        t = simple_exp(numNode);
+        t = simple_exp(ps, factor(ps));
         break;
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
     return t;
 }
 
-TreeNode *simple_exp(TreeNode *addNode)
+/* simple_expression -> additive_expression [ relop additive_expression ]
+   additive_expression -> term { addop term }
+   term -> factor { mulop factor } */
+/* left, the first factor, is already parsed. The rest
+   is parsed by precedence climbing without recursion:
+   operators whose right operand is still to come wait
+   on a stack, in rising precedence, so it never holds
+   more than one per level. Addops and mulops associate
+   to the left; a relop may appear only once */
+TreeNode *simple_exp(CMinusParser *ps, TreeNode *left)
 {
-    TreeNode *t = NULL;
-    TreeNode *addExpNode = NULL;
-    TreeNode *termNode = NULL;
-    if (addNode != NULL)
+    TreeNode *pending[MAX_PREC];
+    TreeNode *t = left;
+    int n = 0, prec, relops = 0;
+    if (t == NULL)
+        return NULL;
+    while ((prec = precOf(ps->token)) > 0 && !(prec == RELOP_PREC && relops > 0))
     {
-        while (token == OVER || token == TIMES)
-        {
-            termNode = newExpNode(OpK);
-            termNode->attr.op = token;
-            match(token);
-            termNode->child[0] = addNode;
-            termNode->child[1] = term();
-        }
-        if (termNode == NULL)
-            termNode = addNode;
-        while (token == MINUS || token == PLUS)
-        {
-            addExpNode = newExpNode(OpK);
-            addExpNode->attr.op = token;
-            match(token);
-            addExpNode->child[0] = termNode;
-            addExpNode->child[1] = additive_exp();
-        }
-        if (addExpNode == NULL)
-            addExpNode = termNode;
-        if (relop(token))
+        TreeNode *op = newExpNodeWith(ps, OpK);
+        op->attr.op = ps->token;
+        relops += prec == RELOP_PREC;
+        match(ps, ps->token);
+        /* t is the right operand of the waiting operators
+           that bind at least as tightly as this one */
+        while (n > 0 && precOf(pending[n - 1]->attr.op) >= prec)
         {
-            t = newExpNode(OpK);
-            t->attr.op = token;
-            match(token);
-            t->child[0] = addExpNode;
-            t->child[1] = additive_exp();
+            pending[n - 1]->child[1] = t;
+            t = pending[--n];
         }
-
-        if (t == NULL)
-            t = addExpNode;
-    }
-    return t;
-}
-
-/* additive_expression ->  term  { addop term } */
-TreeNode *additive_exp()
-{
-    TreeNode *t = NULL;
-    TreeNode *termNode = term();
-    if (token == PLUS || token == MINUS)
-    {
-        t = newExpNode(OpK);
-        t->attr.op = token;
-        match(token);
-        t->child[0] = termNode;
-        t->child[1] = additive_exp();
+        op->child[0] = t;
+        pending[n++] = op;
+        t = factor(ps);
     }
-    else if (relop(token) || token == RPAREN || token == SEMI || token == COMMA)
+    while (n > 0)
     {
-        t = termNode;
-    }
-    return t;
-}
-
-TreeNode *term(void)
-{
-    TreeNode *t = NULL;
-    TreeNode *factorNode = factor();
-    if (token == OVER || token == TIMES)
-    {
-        t = newExpNode(OpK);
-        t->attr.op = token;
-        match(token);
-        t->child[0] = factorNode;
-        t->child[1] = term();
-    }
-    else if (token == MINUS || token == PLUS || token == RPAREN || token == SEMI || token == COMMA)
-    {
-        t = factorNode;
+        pending[n - 1]->child[1] = t;
+        t = pending[--n];
     }
     return t;
 }
 
 /* args -> expression   {  , expression }   |  empty */
-TreeNode *args(void)
+TreeNode *args(CMinusParser *ps)
 {
     TreeNode *t = NULL;
     TreeNode *p = NULL;
-    switch (token)
+    switch (ps->token)
     {
     case RPAREN:
         return NULL;
@@ -739,20 +825,27 @@ TreeNode *args(void)
     case ID:
     case LPAREN:
     case NUM:
-        t = newExpNode(ArgsK);
-        t->child[0] = exp();
+        t = newExpNodeWith(ps, ArgsK);
+        t->child[0] = exp(ps);
         p = t->child[0];
-        while (token == COMMA)
+        while (ps->token == COMMA)
         {
-            match(COMMA);
-            p->sibling = exp();
-            p = p->sibling;
+            TreeNode *q;
+            match(ps, COMMA);
+            /* arguments with syntax errors are left out */
+            if ((q = exp(ps)) == NULL)
+                continue;
+            if (p == NULL)
+                t->child[0] = q;
+            else
+                p->sibling = q;
+            p = q;
         }
         break;
     default:
-        syntaxError("unexpected token -> ");
-        printToken(token, tokenString);
-        token = getToken();
+        syntaxError(ps, "unexpected token -> ");
+        printCurrentToken(ps);
+        ps->token = nextTokenWith(ps);
         break;
     }
 
@@ -762,15 +855,93 @@ TreeNode *args(void)
 /****************************************/
 /* the primary function of the parser   */
 /****************************************/
+/* Function parseWith returns the syntax tree
+ * of the parser's source file
+ */
+TreeNode *parseWith(CMinusParser *ps)
+{
+    TreeNode *t;
+    ps->token = nextTokenWith(ps);
+    t = program(ps);
+    if (ps->token != ENDFILE)
+        syntaxError(ps, "Code ends before file\n");
+    outFlush(&ps->out);
+    return t;
+}
+
+/* Function parseTokensWith returns the syntax tree
+ * of tokens, the whole source of the parser already
+ * scanned by tokenizeWith, without scanning again
+ */
+TreeNode *parseTokensWith(CMinusParser *ps, const TokenArray *tokens)
+{
+    TreeNode *t;
+    ps->tokenArray = tokens;
+    ps->tokenIndex = 0;
+    ps->tokenCount = 0;
+    t = parseWith(ps);
+    ps->tokenArray = NULL;
+    return t;
+}
+
+/* Procedure initParser prepares a parser to read
+ * source and write its listing to listing
+ */
+void initParser(CMinusParser *ps, FILE *source, FILE *listing)
+{
+    memset(ps, 0, sizeof(*ps));
+    ps->source = source;
+    ps->listing = listing;
+    ps->out.file = listing;
+    ps->echoSource = EchoSource;
+    ps->traceScan = TraceScan;
+}
+
+/* Procedure closeParser writes out the parser's
+ * pending listing text and releases its source
+ * buffer and every tree it has built
+ */
+void closeParser(CMinusParser *ps)
+{
+    freeOutBuf(&ps->out);
+    closeSource(ps);
+    freeTreesWith(ps);
+}
+
+/* Procedure flushListing writes the parser's pending
+ * listing text to its listing file; needed only after
+ * calling getTokenWith directly
+ */
+void flushListing(CMinusParser *ps)
+{
+    outFlush(&ps->out);
+}
+
+/* the parser behind the global API; it is set up
+   from source and listing on first use */
+static CMinusParser theParser;
+static int theParserReady = FALSE;
+
+/* Function defaultParser returns the parser used by
+ * getToken, parse and the other global functions
+ */
+CMinusParser *defaultParser(void)
+{
+    if (!theParserReady)
+    {
+        initParser(&theParser, source, listing);
+        theParserReady = TRUE;
+    }
+    return &theParser;
+}
+
 /* Function parse returns the newly
  * constructed syntax tree
  */
 TreeNode *parse(void)
 {
-    TreeNode *t;
-    token = getToken();
-    t = program();
-    if (token != ENDFILE)
-        syntaxError("Code ends before file\n");
+    CMinusParser *ps = defaultParser();
+    TreeNode *t = parseWith(ps);
+    lineno = ps->lineno;
     return t;
 }
@@ -6,4 +6,37 @@
  */
 TreeNode * parse(void);
 
+/* Function parseWith returns the syntax tree
+ * of the parser's source file
+ */
+TreeNode *parseWith(CMinusParser *);
+
+/* Function parseTokensWith returns the syntax tree
+ * of tokens, the whole source of the parser already
+ * scanned by tokenizeWith, without scanning again
+ */
+TreeNode *parseTokensWith(CMinusParser *, const TokenArray *tokens);
+
+/* Procedure initParser prepares a parser to read
+ * source and write its listing to listing
+ */
+void initParser(CMinusParser *, FILE *source, FILE *listing);
+
+/* Procedure closeParser writes out the parser's
+ * pending listing text and releases its source
+ * buffer and every tree it has built
+ */
+void closeParser(CMinusParser *);
+
+/* Procedure flushListing writes the parser's pending
+ * listing text to its listing file; needed only after
+ * calling getTokenWith directly
+ */
+void flushListing(CMinusParser *);
+
+/* Function defaultParser returns the parser used by
+ * getToken, parse and the other global functions
+ */
+CMinusParser *defaultParser(void);
+
 #endif
@@ -0,0 +1,261 @@
+#include "globals.h"
+#include "util.h"
+#include "scan.h"
+#include "parse.h"
+#include "pparse.h"
+#include "walk.h"
+#include "stats.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+/* chunks per thread, so that threads finishing early
+   can pick up more work */
+#define CHUNKS_PER_THREAD 4
+
+/* where a top-level declaration ends */
+typedef struct
+{
+    const char *pos; /* just past its last char */
+    int lineno;      /* line pos lies on */
+} DeclEnd;
+
+/* a run of whole top-level declarations, parsed by
+   its own CMinusParser into its own listing */
+typedef struct
+{
+    const char *start, *end;
+    int lineno; /* line start lies on */
+    CMinusParser ps;
+    FILE *listing;
+    char *listingText;
+    size_t listingLen;
+    TreeNode *tree;
+    ParseStats stats; /* counted when the parent counts;
+                         added to its once all chunks parse */
+} Chunk;
+
+typedef struct
+{
+    CMinusParser *parent;
+    const char *text, *textEnd;
+    Chunk *chunks;
+    int count;
+    int next; /* next chunk to hand out */
+    pthread_mutex_t lock;
+} ChunkPool;
+
+/* findDeclEnds pre-scans the source for the end of
+   every top-level declaration: a ';' at brace depth 0
+   ends a variable declaration, and the '}' that takes
+   the depth back to 0 ends a function. Comments are
+   skipped the way the scanner skips them. Returns the
+   number of ends found, or -1 if the braces do not
+   balance or a comment is left open */
+static int findDeclEnds(const char *p, const char *end, DeclEnd **ends)
+{
+    int depth = 0, lineno = 1, count = 0, cap = 0;
+    *ends = NULL;
+    while (p < end)
+    {
+        char c = *p++;
+        if (c == '\n')
+            lineno++;
+        else if (c == '/' && p < end && *p == '*')
+        {
+            for (p++; p < end && !(p[0] == '*' && p + 1 < end && p[1] == '/'); p++)
+                if (*p == '\n')
+                    lineno++;
+            if (p >= end)
+                return -1;
+            p += 2;
+        }
+        else if (c == '{')
+            depth++;
+        else if (c == '}' && --depth < 0)
+            return -1;
+        else if ((c == '}' && depth == 0) || (c == ';' && depth == 0))
+        {
+            if (count == cap)
+            {
+                DeclEnd *grown = realloc(*ends, (cap = cap ? cap * 2 : 256) * sizeof(DeclEnd));
+                if (grown == NULL)
+                    return -1;
+                *ends = grown;
+            }
+            (*ends)[count].pos = p;
+            (*ends)[count].lineno = lineno;
+            count++;
+        }
+    }
+    return depth == 0 ? count : -1;
+}
+
+/* parseChunk parses one chunk; the chunk's first
+   line is already echoed when it starts mid-line */
+static void parseChunk(ChunkPool *pool, Chunk *c)
+{
+    int midLine = c->start > pool->text && c->start[-1] != '\n';
+    c->listing = open_memstream(&c->listingText, &c->listingLen);
+    initParser(&c->ps, NULL, c->listing);
+    c->ps.echoSource = pool->parent->echoSource;
+    c->ps.traceScan = FALSE;
+    if (pool->parent->stats != NULL)
+        c->ps.stats = &c->stats;
+    setSourceText(&c->ps, c->start, c->end, pool->textEnd, c->lineno, midLine);
+    c->ps.spanBase = pool->text;
+    if (c->listing == NULL)
+    {
+        c->ps.errorCount = 1; /* forces the sequential parse */
+        return;
+    }
+    c->tree = parseWith(&c->ps);
+    fflush(c->listing);
+}
+
+static void *chunkWorker(void *arg)
+{
+    ChunkPool *pool = arg;
+    for (;;)
+    {
+        int i;
+        pthread_mutex_lock(&pool->lock);
+        i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (i >= pool->count)
+            break;
+        parseChunk(pool, &pool->chunks[i]);
+    }
+    return NULL;
+}
+
+/* reintern points an IdK name at the parent parser's
+   shared copy, so names still compare by pointer
+   across chunks */
+static int reintern(TreeNode *t, const WalkPos *pos, void *arg)
+{
+    CMinusParser *ps = arg;
+    if (t->nodekind == ExpK && t->kind.exp == IdK && t->attr.name != NULL)
+        t->attr.name = (char *)internNameWith(ps, t->attr.name, strlen(t->attr.name));
+    return WALK_CONTINUE;
+}
+
+/* Function parseParallelWith returns the syntax tree
+ * of the parser's source file like parseWith, parsing
+ * runs of top-level declarations in parallel
+ */
+TreeNode *parseParallelWith(CMinusParser *ps, int threads)
+{
+    ChunkPool pool;
+    DeclEnd *ends;
+    pthread_t *tids;
+    TreeNode *tree = NULL, *last = NULL;
+    size_t len, target;
+    const char *start;
+    int nends, i, lineno, started = 0, errors = 0;
+
+    if (ps->traceScan)
+        return parseWith(ps);
+    pool.text = sourceText(ps, &len);
+    pool.textEnd = pool.text + len;
+    nends = findDeclEnds(pool.text, pool.textEnd, &ends);
+    if (nends < 2)
+    {
+        free(ends);
+        return parseWith(ps);
+    }
+    if (threads <= 0)
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads < 1)
+        threads = 1;
+
+    /* group declarations into chunks of roughly equal
+       size; the last chunk runs to the end of the file */
+    pool.chunks = calloc(nends, sizeof(Chunk));
+    tids = calloc(threads, sizeof(pthread_t));
+    if (pool.chunks == NULL || tids == NULL)
+    {
+        free(pool.chunks);
+        free(tids);
+        free(ends);
+        return parseWith(ps);
+    }
+    target = len / ((size_t)threads * CHUNKS_PER_THREAD) + 1;
+    pool.count = 0;
+    start = pool.text;
+    lineno = 1;
+    for (i = 0; i < nends; i++)
+    {
+        Chunk *c = &pool.chunks[pool.count];
+        if (i < nends - 1 && (size_t)(ends[i].pos - start) < target)
+            continue;
+        c->start = start;
+        c->end = i == nends - 1 ? pool.textEnd : ends[i].pos;
+        c->lineno = lineno;
+        pool.count++;
+        start = ends[i].pos;
+        lineno = ends[i].lineno;
+    }
+    free(ends);
+
+    pool.parent = ps;
+    pool.next = 0;
+    pthread_mutex_init(&pool.lock, NULL);
+    if (threads > pool.count)
+        threads = pool.count;
+    /* the calling thread takes chunks too, so they all
+       get parsed even if no thread starts */
+    for (i = 1; i < threads; i++)
+        if (pthread_create(&tids[started], NULL, chunkWorker, &pool) == 0)
+            started++;
+    chunkWorker(&pool);
+    for (i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+    pthread_mutex_destroy(&pool.lock);
+    free(tids);
+
+    for (i = 0; i < pool.count; i++)
+        errors += pool.chunks[i].ps.errorCount;
+    /* a tree that cannot be walked is parsed again
+       like one with errors */
+    for (i = 0; errors == 0 && i < pool.count; i++)
+        if (walkTree(pool.chunks[i].tree, reintern, NULL, ps) < 0)
+            errors++;
+    for (i = 0; i < pool.count; i++)
+    {
+        Chunk *c = &pool.chunks[i];
+        if (errors == 0)
+        {
+            outWrite(&ps->out, c->listingText, c->listingLen);
+            adoptArena(&ps->arena, &c->ps.arena);
+            if (last == NULL)
+                tree = c->tree;
+            else
+                last->sibling = c->tree;
+            if (c->tree != NULL)
+                for (last = c->tree; last->sibling != NULL; last = last->sibling)
+                    ;
+            ps->lineno = c->ps.lineno;
+            /* only the last chunk's ENDFILE ends the file */
+            if (i < pool.count - 1)
+                c->stats.tokens--;
+            if (ps->stats != NULL)
+                addParseStats(ps->stats, &c->stats);
+        }
+        if (c->listing != NULL)
+            fclose(c->listing);
+        free(c->listingText);
+        closeParser(&c->ps);
+    }
+    free(pool.chunks);
+    if (errors > 0)
+        return parseWith(ps);
+
+    /* leave the parser at the end of its input, as
+       parseWith would */
+    ps->srcPos = ps->lineEnd = ps->srcEnd;
+    ps->EOF_flag = TRUE;
+    ps->token = ENDFILE;
+    outFlush(&ps->out);
+    return tree;
+}
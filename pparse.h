@@ -0,0 +1,16 @@
+#ifndef _PPARSE_H_
+#define _PPARSE_H_
+
+/* Function parseParallelWith returns the syntax tree
+ * of the parser's source file like parseWith, but
+ * parses runs of top-level declarations on up to
+ * threads threads (one per core if threads is 0) and
+ * stitches the results together in source order.
+ * The tree, the listing and any syntax errors are
+ * exactly those of parseWith: a file with syntax
+ * errors, or with TraceScan on, is parsed
+ * sequentially.
+ */
+TreeNode *parseParallelWith(CMinusParser *, int threads);
+
+#endif
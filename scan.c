@@ -1,6 +1,12 @@
 #include "globals.h"
 #include "scan.h"
 #include "util.h"
+#include "parse.h"
+#include "scanfast.h"
+
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* states in scanner DFA */
 typedef enum
@@ -18,79 +24,488 @@ typedef enum
     DONE
 } StateType;
 
-/* lexeme of identifier or reserved word */
+/* lexeme of the last token read through getToken */
 char tokenString[MAXTOKENLEN + 1];
 
-/* BUFLEN = length of the input buffer for
-   source code lines */
-#define BUFLEN 256
+/* interned lexeme of the last ID token read through
+   getToken */
+const char *tokenName = NULL;
 
-static char lineBuf[BUFLEN]; /* holds the current line */
-static int linepos = 0;      /* current position in LineBuf */
-static int bufsize = 0;      /* current size of buffer string */
-static int EOF_flag = FALSE; /* corrects ungetNextChar behavior on EOF */
+/* The whole source file is mapped (or, when it cannot
+   be mapped, read) into a single buffer which the
+   scanner walks with a raw pointer; the buffer and
+   all scanner state live in the CMinusParser */
 
-/* getNextChar fetches the next non-blank character
-   from lineBuf, reading in a new line if lineBuf is
-   exhausted */
-static int getNextChar(void)
+/* readSource reads the rest of source into a malloc'd
+   buffer; used for pipes and other unmappable input */
+static void readSource(CMinusParser *ps)
 {
-    if (!(linepos < bufsize))
+    size_t cap = 1 << 16, len = 0, n;
+    char *buf = malloc(cap);
+    while (buf != NULL && (n = fread(buf + len, 1, cap - len, ps->source)) > 0)
     {
-        lineno++;
-        if (fgets(lineBuf, BUFLEN - 1, source))
+        len += n;
+        if (len == cap)
         {
-            if (EchoSource)
-                fprintf(listing, "%4d: %s", lineno, lineBuf);
-            bufsize = strlen(lineBuf);
-            linepos = 0;
-            return lineBuf[linepos++];
+            char *grown = realloc(buf, cap *= 2);
+            if (grown == NULL)
+                free(buf);
+            buf = grown;
+        }
+    }
+    if (buf == NULL)
+    {
+        outStr(&ps->out, "Out of memory error reading source\n");
+        len = 0;
+        buf = "";
+    }
+    else
+        ps->srcAlloc = buf;
+    ps->srcBuf = buf;
+    ps->srcEnd = buf + len;
+}
+
+static void checkReservedWords(void);
+#ifdef TABLE_SCANNER
+static void initScanTables(void);
+#endif
+
+/* initScanner sets up the tables shared by every
+   parser; run once, whichever thread scans first */
+static pthread_once_t scannerReady = PTHREAD_ONCE_INIT;
+static void initScanner(void)
+{
+    checkReservedWords();
+    initScanFast();
+#ifdef TABLE_SCANNER
+    initScanTables();
+#endif
+}
+
+/* loadSource makes the whole source file available
+   in memory, mapping it when possible */
+static void loadSource(CMinusParser *ps)
+{
+    struct stat st;
+    int fd = fileno(ps->source);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            ps->srcBuf = map;
+            ps->srcEnd = ps->srcBuf + st.st_size;
+            ps->srcMapped = (size_t)st.st_size;
+        }
+    }
+    if (ps->srcBuf == NULL)
+        readSource(ps);
+    ps->srcPos = ps->lineEnd = ps->srcBuf;
+    ps->textEnd = ps->srcEnd;
+    ps->spanBase = ps->srcBuf;
+    pthread_once(&scannerReady, initScanner);
+}
+
+/* Function sourceText returns the parser's whole
+ * source text, loading it if scanning has not begun,
+ * and stores its length in len
+ */
+const char *sourceText(CMinusParser *ps, size_t *len)
+{
+    if (ps->srcBuf == NULL)
+        loadSource(ps);
+    *len = ps->srcEnd - ps->srcBuf;
+    return ps->srcBuf;
+}
+
+/* Procedure setSourceText makes the parser scan the
+ * borrowed chars [text, end) instead of its source
+ * file. text lies within a larger buffer ending at
+ * textEnd, from which whole lines are echoed; lineno
+ * is the line text starts on, and when text starts
+ * mid-line that line counts as already read. Node
+ * spans are measured from text until spanBase is set
+ */
+void setSourceText(CMinusParser *ps, const char *text, const char *end, const char *textEnd, int lineno, int midLine)
+{
+    ps->srcBuf = ps->srcPos = ps->spanBase = text;
+    ps->srcEnd = end;
+    ps->EOF_flag = FALSE;
+    ps->tokenCount = 0;
+    ps->prevEnd = text;
+    ps->textEnd = textEnd;
+    ps->lineno = lineno - 1;
+    ps->lineEnd = text;
+    if (midLine)
+    {
+        const char *nl = memchr(text, '\n', end - text);
+        ps->lineEnd = nl ? nl + 1 : end;
+        ps->lineno = lineno;
+    }
+    pthread_once(&scannerReady, initScanner);
+}
+
+/* Procedure seekSource moves the scanner to pos, a
+ * token boundary on line lineno within the text being
+ * scanned, as if it had just read up to pos
+ */
+void seekSource(CMinusParser *ps, const char *pos, int lineno)
+{
+    const char *nl = memchr(pos, '\n', ps->srcEnd - pos);
+    ps->srcPos = pos;
+    ps->lineEnd = nl ? nl + 1 : ps->srcEnd;
+    ps->lineno = lineno;
+    ps->EOF_flag = FALSE;
+    ps->tokenCount = 0;
+    ps->prevEnd = pos;
+}
+
+/* getNextChar fetches the next character from the
+   source buffer; crossing into a new line bumps lineno
+   and echoes the line, whose end is found lazily.
+   Scanning stops at srcEnd even mid-line, but the
+   echo shows the line in full */
+static int getNextChar(CMinusParser *ps)
+{
+    if (ps->srcPos >= ps->lineEnd)
+    {
+        if (ps->srcBuf == NULL)
+            loadSource(ps);
+        ps->lineno++;
+        if (ps->srcPos < ps->srcEnd)
+        {
+            const char *nl = memchr(ps->srcPos, '\n', ps->textEnd - ps->srcPos);
+            const char *end = nl ? nl + 1 : ps->textEnd;
+            if (ps->echoSource)
+            {
+                outInt(&ps->out, ps->lineno, 4);
+                outWrite(&ps->out, ": ", 2);
+                /* stops at a NUL like the %.*s it replaces */
+                outWrite(&ps->out, ps->srcPos, strnlen(ps->srcPos, end - ps->srcPos));
+            }
+            ps->lineEnd = end < ps->srcEnd ? end : ps->srcEnd;
         }
         else
         {
-            EOF_flag = TRUE;
+            ps->EOF_flag = TRUE;
             return EOF;
         }
     }
-    else
-        return lineBuf[linepos++];
+    return *ps->srcPos++;
+}
+
+/* Procedure closeSource releases the parser's
+ * source buffer
+ */
+void closeSource(CMinusParser *ps)
+{
+    if (ps->srcMapped > 0)
+        munmap((void *)ps->srcBuf, ps->srcMapped);
+    free(ps->srcAlloc);
+    ps->srcBuf = ps->srcEnd = ps->srcPos = ps->lineEnd = ps->textEnd = NULL;
+    ps->srcAlloc = NULL;
+    ps->srcMapped = 0;
 }
 
 /* ungetNextChar backtracks one character
-   in lineBuf */
-static void ungetNextChar(void)
+   in the source buffer */
+static void ungetNextChar(CMinusParser *ps)
+{
+    if (!ps->EOF_flag)
+        ps->srcPos--;
+}
+
+/* fastForward consumes the rest of a run that state
+   would otherwise take one char at a time: blanks in
+   START, letters in INID, digits in INNUM, and comment
+   text up to the next '*' in INCOMMENT. Runs stop at
+   the end of the current line so that line crossing
+   stays in getNextChar. Returns the updated lexeme
+   length. */
+static int fastForward(CMinusParser *ps, StateType state, int tokenStringIndex)
 {
-    if (!EOF_flag)
-        linepos--;
+    const char *runEnd;
+    int n;
+    /* most runs are a single char or none at all, so
+       peek at the next char before calling a kernel */
+    if (ps->srcPos >= ps->lineEnd)
+        return tokenStringIndex;
+    switch (state)
+    {
+    case START:
+        if (ps->srcPos[0] == ' ' || ps->srcPos[0] == '\t')
+            ps->srcPos = skipSpaces(ps->srcPos + 1, ps->lineEnd);
+        return tokenStringIndex;
+    case INCOMMENT:
+        if (ps->srcPos[0] != '*')
+            ps->srcPos = findStar(ps->srcPos + 1, ps->lineEnd);
+        return tokenStringIndex;
+    case INID:
+        if (!IS_LETTER(ps->srcPos[0]))
+            return tokenStringIndex;
+        runEnd = skipLetters(ps->srcPos + 1, ps->lineEnd);
+        break;
+    case INNUM:
+        if (!IS_DIGIT(ps->srcPos[0]))
+            return tokenStringIndex;
+        runEnd = skipDigits(ps->srcPos + 1, ps->lineEnd);
+        break;
+    default:
+        return tokenStringIndex;
+    }
+    n = runEnd - ps->srcPos;
+    if (n > MAXTOKENLEN - tokenStringIndex)
+        n = MAXTOKENLEN - tokenStringIndex;
+    memcpy(ps->tokenString + tokenStringIndex, ps->srcPos, n);
+    ps->srcPos = runEnd;
+    return tokenStringIndex + n;
 }
 
-/* lookup table of reserved words */
-static struct
+/* perfect hash table of reserved words, indexed by
+   RESERVED_HASH; the hash (length plus twice the first
+   char, mod 8) was chosen offline so that the six C-
+   keywords land in distinct slots, which
+   checkReservedWords verifies when the scanner starts */
+#define RESERVED_HASH(s, len) (((len) + ((unsigned char)(s)[0] << 1)) & 7)
+
+static const struct
 {
-    char *str;
+    const char *str;
+    int len;
     TokenType tok;
-} reservedWords[MAXRESERVED] = {{"if", IF}, {"else", ELSE}, {"int", INT}, {"return", RETURN}, {"void", VOID}, {"while", WHILE}};
+} reservedWords[8] = {
+    {"void", 4, VOID},   /* 4 + 2*'v' = 240 */
+    {NULL, 0, ID},
+    {"return", 6, RETURN}, /* 6 + 2*'r' = 234 */
+    {"while", 5, WHILE}, /* 5 + 2*'w' = 243 */
+    {"if", 2, IF},       /* 2 + 2*'i' = 212 */
+    {"int", 3, INT},     /* 3 + 2*'i' = 213 */
+    {"else", 4, ELSE},   /* 4 + 2*'e' = 206 */
+    {NULL, 0, ID},
+};
 
 /* lookup an identifier to see if it is a reserved word */
-/* uses linear search */
-static TokenType reservedLookup(char *s)
+/* uses a perfect hash: at most one comparison per id */
+TokenType reservedLookup(const char *s, int len)
+{
+    int h;
+    if (len < 2 || len > 6)
+        return ID;
+    h = RESERVED_HASH(s, len);
+    if (reservedWords[h].len == len && !memcmp(s, reservedWords[h].str, len))
+        return reservedWords[h].tok;
+    return ID;
+}
+
+/* checkReservedWords makes sure every reserved word
+   sits in the slot it hashes to, with its true length,
+   so that reservedLookup finds it; a clash after a
+   change to the hash or the keywords stops the program
+   rather than scanning keywords as IDs */
+static void checkReservedWords(void)
+{
+    static const struct
+    {
+        const char *str;
+        TokenType tok;
+    } words[MAXRESERVED] = {{"if", IF}, {"else", ELSE}, {"int", INT}, {"return", RETURN}, {"void", VOID}, {"while", WHILE}};
+    int i, used = 0;
+    for (i = 0; i < (int)(sizeof(reservedWords) / sizeof(reservedWords[0])); i++)
+        used += reservedWords[i].str != NULL;
+    for (i = 0; i < MAXRESERVED && used == MAXRESERVED; i++)
+        if (reservedLookup(words[i].str, (int)strlen(words[i].str)) != words[i].tok)
+            break;
+    if (i < MAXRESERVED)
+    {
+        fprintf(stderr, "reserved word table does not match RESERVED_HASH\n");
+        abort();
+    }
+}
+
+/* traceToken prints a recognized token to the
+   listing file when TraceScan is set */
+static void traceToken(CMinusParser *ps, TokenType currentToken)
 {
-    int i;
-    for (i = 0; i < MAXRESERVED; i++)
+    if (currentToken != ENDFILE)
     {
-        if (!strcmp(s, reservedWords[i].str))
-            return reservedWords[i].tok;
+        outChar(&ps->out, '\t');
+        outInt(&ps->out, ps->lineno, 0);
     }
-    return ID;
+    else
+        outInt(&ps->out, ps->lineno, 4); /* compromise here may cause bug */
+    outWrite(&ps->out, ": ", 2);
+    printTokenWith(ps, currentToken, ps->tokenString);
+}
+
+#ifdef TABLE_SCANNER
+
+/* table-driven scanner backend, selected at build time
+   with -DTABLE_SCANNER (make SCANNER=table).
+
+   Every char is mapped to a class by charClass; the
+   classes reuse TokenType: a char's class is the token
+   it starts (ID for letters, NUM for digits, PLUS for
+   '+', ENDFILE for EOF, ERROR for anything unknown),
+   plus two classes that start no token of their own */
+#define C_SPACE (RBRACE + 1)
+#define C_TILDE (RBRACE + 2)
+#define NCLASSES (RBRACE + 3)
+
+/* chars reach the scanner as (signed) char values or
+   EOF, so the table is indexed by c + 128 */
+#define CLASS_INDEX(c) ((c) + 128)
+static unsigned char charClass[256];
+
+/* one DFA step: the state to move to, how to adjust
+   the lexeme (+1 keep c, 0 discard c, -1 also drop
+   the previously kept char), whether to push c back,
+   and the token recognized when next is DONE */
+typedef struct
+{
+    unsigned char next;
+    signed char keep;
+    unsigned char unget;
+    unsigned char token;
+} Transition;
+
+static Transition transitions[DONE][NCLASSES];
+
+/* setRow fills every class of state with the same
+   transition */
+static void setRow(StateType state, StateType next, int keep, int unget, TokenType token)
+{
+    int cls;
+    for (cls = 0; cls < NCLASSES; cls++)
+        transitions[state][cls] = (Transition){next, keep, unget, token};
+}
+
+/* set fills one class of state */
+static void set(StateType state, int cls, StateType next, int keep, int unget, TokenType token)
+{
+    transitions[state][cls] = (Transition){next, keep, unget, token};
+}
+
+/* initScanTables builds the class and transition
+   tables from the token set */
+static void initScanTables(void)
+{
+    static const struct
+    {
+        char c;
+        TokenType cls;
+    } symbols[] = {{'+', PLUS}, {'-', MINUS}, {'*', TIMES}, {'/', OVER}, {'<', LT}, {'>', GT}, {'=', ASSIGN}, {'(', LPAREN}, {')', RPAREN}, {';', SEMI}, {',', COMMA}, {'[', LBRACKET}, {']', RBRACKET}, {'{', LBRACE}, {'}', RBRACE}};
+    int c, i;
+
+    memset(charClass, ERROR, sizeof(charClass));
+    for (c = 'a'; c <= 'z'; c++)
+        charClass[CLASS_INDEX(c)] = charClass[CLASS_INDEX(c - 'a' + 'A')] = ID;
+    for (c = '0'; c <= '9'; c++)
+        charClass[CLASS_INDEX(c)] = NUM;
+    charClass[CLASS_INDEX(' ')] = charClass[CLASS_INDEX('\t')] = C_SPACE;
+    charClass[CLASS_INDEX('\n')] = charClass[CLASS_INDEX('\r')] = C_SPACE;
+    charClass[CLASS_INDEX('~')] = C_TILDE;
+    charClass[CLASS_INDEX(EOF)] = ENDFILE;
+    for (i = 0; i < (int)(sizeof(symbols) / sizeof(symbols[0])); i++)
+        charClass[CLASS_INDEX(symbols[i].c)] = symbols[i].cls;
+
+    /* single-char symbols are recognized straight from START */
+    for (i = PLUS; i <= RBRACE; i++)
+        set(START, i, DONE, 1, FALSE, i);
+    set(START, ENDFILE, DONE, 0, FALSE, ENDFILE);
+    set(START, ERROR, DONE, 1, FALSE, ERROR);
+    set(START, C_SPACE, START, 0, FALSE, ERROR);
+    set(START, ID, INID, 1, FALSE, ERROR);
+    set(START, NUM, INNUM, 1, FALSE, ERROR);
+    set(START, LT, INLE, 1, FALSE, ERROR);
+    set(START, GT, INGE, 1, FALSE, ERROR);
+    set(START, ASSIGN, INEQ, 1, FALSE, ERROR);
+    set(START, C_TILDE, INNEQ, 1, FALSE, ERROR);
+    set(START, OVER, LCOMMENT, 1, FALSE, ERROR);
+
+    setRow(INID, DONE, 0, TRUE, ID);
+    set(INID, ID, INID, 1, FALSE, ERROR);
+    setRow(INNUM, DONE, 0, TRUE, NUM);
+    set(INNUM, NUM, INNUM, 1, FALSE, ERROR);
+
+    setRow(INLE, DONE, 0, TRUE, LT);
+    set(INLE, ASSIGN, DONE, 1, FALSE, LE);
+    setRow(INGE, DONE, 0, TRUE, GT);
+    set(INGE, ASSIGN, DONE, 1, FALSE, GE);
+    setRow(INEQ, DONE, 0, TRUE, ASSIGN);
+    set(INEQ, ASSIGN, DONE, 1, FALSE, EQ);
+    setRow(INNEQ, DONE, 0, TRUE, ERROR);
+    set(INNEQ, ASSIGN, DONE, 1, FALSE, NEQ);
+
+    /* a comment opener drops the '/' already kept */
+    setRow(LCOMMENT, DONE, 0, TRUE, OVER);
+    set(LCOMMENT, TIMES, INCOMMENT, -1, FALSE, ERROR);
+    setRow(INCOMMENT, INCOMMENT, 0, FALSE, ERROR);
+    set(INCOMMENT, TIMES, RCOMMENT, 0, FALSE, ERROR);
+    set(INCOMMENT, ENDFILE, DONE, 0, FALSE, ENDFILE);
+    setRow(RCOMMENT, INCOMMENT, 0, FALSE, ERROR);
+    set(RCOMMENT, TIMES, RCOMMENT, 0, FALSE, ERROR);
+    set(RCOMMENT, OVER, START, 0, FALSE, ERROR);
+    set(RCOMMENT, ENDFILE, DONE, 0, FALSE, ENDFILE);
 }
 
 /****************************************/
 /* the primary function of the scanner  */
 /****************************************/
-/* function getToken returns the
- * next token in source file
+/* function getTokenWith returns the
+ * next token in the parser's source file
  */
-TokenType getToken(void)
+TokenType getTokenWith(CMinusParser *ps)
+{
+    /* index for storing into tokenString */
+    int tokenStringIndex = 0;
+    /* holds current token to be returned */
+    TokenType currentToken;
+    /* current state - always begins at START */
+    StateType state = START;
+    const Transition *t;
+    const char *tokenStart = NULL;
+    /* the first getNextChar loads the source, and with
+       it the tables */
+    do
+    {
+        int c = getNextChar(ps);
+        if (state == START)
+            tokenStart = ps->srcPos - (c != EOF);
+        t = &transitions[state][charClass[CLASS_INDEX(c)]];
+        if (t->unget)
+            ungetNextChar(ps);
+        /* the slot at tokenStringIndex is always writable;
+           it only becomes part of the lexeme if kept */
+        ps->tokenString[tokenStringIndex] = (char)c;
+        tokenStringIndex += t->keep;
+        if (tokenStringIndex > MAXTOKENLEN)
+            tokenStringIndex = MAXTOKENLEN;
+        state = t->next;
+        if (state != DONE)
+            tokenStringIndex = fastForward(ps, state, tokenStringIndex);
+    } while (state != DONE);
+    ps->tokenString[tokenStringIndex] = '\0';
+    currentToken = t->token;
+    if (currentToken == ID)
+        currentToken = reservedLookup(ps->tokenString, tokenStringIndex);
+    if (currentToken == ID)
+        ps->tokenName = internNameWith(ps, tokenStart, (int)(ps->srcPos - tokenStart));
+    ps->tokenStart = tokenStart;
+    ps->tokenEnd = ps->srcPos;
+    if (ps->traceScan)
+        traceToken(ps, currentToken);
+    return currentToken;
+} /* end getTokenWith */
+
+#else /* switch-based scanner backend */
+
+/****************************************/
+/* the primary function of the scanner  */
+/****************************************/
+/* function getTokenWith returns the
+ * next token in the parser's source file
+ */
+TokenType getTokenWith(CMinusParser *ps)
 {
     /* index for storing into tokenString */
     int tokenStringIndex = 0;
@@ -100,17 +515,20 @@ TokenType getToken(void)
     StateType state = START;
     /* flag to indicate save to tokenString */
     int save;
+    const char *tokenStart = NULL;
     while (state != DONE)
     {
-        int c = getNextChar();
+        int c = getNextChar(ps);
         save = TRUE;
+        if (state == START)
+            tokenStart = ps->srcPos - (c != EOF);
 
         switch (state)
         {
         case START:
-            if (isdigit(c))
+            if (IS_DIGIT(c))
                 state = INNUM;
-            else if (isalpha(c))
+            else if (IS_LETTER(c))
                 state = INID;
             else if (c == '<')
                 state = INLE;
@@ -179,7 +597,7 @@ TokenType getToken(void)
             else
             {
                 /* backup in the input */
-                ungetNextChar();
+                ungetNextChar(ps);
                 save = FALSE;
                 currentToken = ASSIGN;
             }
@@ -191,7 +609,7 @@ TokenType getToken(void)
             else
             {
                 /* backup in the input */
-                ungetNextChar();
+                ungetNextChar(ps);
                 save = FALSE;
                 currentToken = ERROR;
             }
@@ -203,7 +621,7 @@ TokenType getToken(void)
             else
             {
                 /* backup in the input */
-                ungetNextChar();
+                ungetNextChar(ps);
                 save = FALSE;
                 currentToken = LT;
             }
@@ -215,26 +633,26 @@ TokenType getToken(void)
             else
             {
                 /* backup in the input */
-                ungetNextChar();
+                ungetNextChar(ps);
                 save = FALSE;
                 currentToken = GT;
             }
             break;
         case INNUM:
-            if (!isdigit(c))
+            if (!IS_DIGIT(c))
             {
                 /* backup in the input */
-                ungetNextChar();
+                ungetNextChar(ps);
                 save = FALSE;
                 state = DONE;
                 currentToken = NUM;
             }
             break;
         case INID:
-            if (!isalpha(c))
+            if (!IS_LETTER(c))
             {
                 /* backup in the input */
-                ungetNextChar();
+                ungetNextChar(ps);
                 save = FALSE;
                 state = DONE;
                 currentToken = ID;
@@ -245,12 +663,12 @@ TokenType getToken(void)
             {
                 save = FALSE;
                 state = INCOMMENT;
-                strcpy(tokenString, "");
+                strcpy(ps->tokenString, "");
                 tokenStringIndex--;
             }
             else
             {
-                ungetNextChar();
+                ungetNextChar(ps);
                 state = DONE;
                 currentToken = OVER;
             }
@@ -282,27 +700,173 @@ TokenType getToken(void)
         case DONE:
         default:
             /* should never happen */
-            fprintf(listing, "Scanner Bug: state= %d\n", state);
+            outPrintf(&ps->out, "Scanner Bug: state= %d\n", state);
             state = DONE;
             currentToken = ERROR;
             break;
         }
-        if (save && tokenStringIndex <= MAXTOKENLEN)
-            tokenString[tokenStringIndex++] = (char)c;
+        if (save && tokenStringIndex < MAXTOKENLEN)
+            ps->tokenString[tokenStringIndex++] = (char)c;
+        if (state != DONE)
+            tokenStringIndex = fastForward(ps, state, tokenStringIndex);
         if (state == DONE)
         {
-            tokenString[tokenStringIndex] = '\0';
+            ps->tokenString[tokenStringIndex] = '\0';
+            if (currentToken == ID)
+                currentToken = reservedLookup(ps->tokenString, tokenStringIndex);
             if (currentToken == ID)
-                currentToken = reservedLookup(tokenString);
+                ps->tokenName = internNameWith(ps, tokenStart, (int)(ps->srcPos - tokenStart));
         }
     }
-    if (TraceScan)
+    ps->tokenStart = tokenStart;
+    ps->tokenEnd = ps->srcPos;
+    if (ps->traceScan)
+        traceToken(ps, currentToken);
+    return currentToken;
+} /* end getTokenWith */
+
+#endif /* TABLE_SCANNER */
+
+/* scanInto scans the next token into the record t,
+   or reads it from the parser's token array; past the
+   end of the array ENDFILE repeats */
+static void scanInto(CMinusParser *ps, Token *t)
+{
+    const TokenArray *a = ps->tokenArray;
+    if (a != NULL)
     {
-        if (currentToken != ENDFILE)
-            fprintf(listing, "\t%d: ", lineno);
-        else
-            fprintf(listing, "%4d: ", lineno); /* compromise here may cause bug */
-        printToken(currentToken, tokenString);
+        int i = ps->tokenIndex < a->count - 1 ? ps->tokenIndex++ : a->count - 1;
+        t->type = (TokenType)a->types[i];
+        t->offset = a->offsets[i];
+        t->length = a->lengths[i];
+        t->lineno = a->lines[i];
+        t->name = a->names[i];
+        return;
+    }
+    t->type = getTokenWith(ps);
+    t->offset = (int)(ps->tokenStart - ps->spanBase);
+    t->length = (int)(ps->tokenEnd - ps->tokenStart);
+    t->lineno = ps->lineno;
+    t->name = t->type == ID ? ps->tokenName : NULL;
+}
+
+/* Function nextTokenWith moves the parser's token
+ * stream on to the next token, scanning it unless it
+ * was peeked at already, and returns its type
+ */
+TokenType nextTokenWith(CMinusParser *ps)
+{
+    if (ps->tokenCount > 0)
+    {
+        const Token *t = currentToken(ps);
+        ps->prevEnd = ps->spanBase + t->offset + t->length;
+        ps->tokenHead = (ps->tokenHead + 1) & (LOOKAHEAD - 1);
+        ps->tokenCount--;
+    }
+    if (ps->tokenCount == 0)
+    {
+        scanInto(ps, currentToken(ps));
+        ps->tokenCount = 1;
+    }
+    if (ps->stats != NULL)
+        ps->stats->tokens++;
+    return currentToken(ps)->type;
+}
+
+/* Function peekTokenWith returns the type of the k-th
+ * token after the current one in the parser's token
+ * stream, scanning up to it first if needed
+ */
+TokenType peekTokenWith(CMinusParser *ps, int k)
+{
+    while (ps->tokenCount <= k)
+    {
+        scanInto(ps, &ps->tokens[(ps->tokenHead + ps->tokenCount) & (LOOKAHEAD - 1)]);
+        ps->tokenCount++;
     }
+    return ps->tokens[(ps->tokenHead + k) & (LOOKAHEAD - 1)].type;
+}
+
+/* growArray resizes the malloc'd array whose address
+   is at p to size bytes */
+static int growArray(void *p, size_t size)
+{
+    void *grown = realloc(*(void **)p, size);
+    if (grown == NULL)
+        return FALSE;
+    *(void **)p = grown;
+    return TRUE;
+}
+
+/* growTokens resizes the arrays of a to hold cap
+   tokens; on failure those already resized are kept,
+   for freeTokenArray to release */
+static int growTokens(TokenArray *a, int cap)
+{
+    if (!growArray(&a->types, cap) ||
+        !growArray(&a->offsets, cap * sizeof(int)) ||
+        !growArray(&a->lengths, cap * sizeof(int)) ||
+        !growArray(&a->lines, cap * sizeof(int)) ||
+        !growArray(&a->names, cap * sizeof(char *)))
+        return FALSE;
+    a->cap = cap;
+    return TRUE;
+}
+
+/* Function tokenizeWith scans the parser's whole
+ * source into tokens, up to and including ENDFILE;
+ * returns the number of tokens, or -1 if memory is
+ * exhausted
+ */
+int tokenizeWith(CMinusParser *ps, TokenArray *a)
+{
+    size_t len;
+    TokenType type;
+    memset(a, 0, sizeof(*a));
+    /* C- source averages well over four chars a token */
+    sourceText(ps, &len);
+    if (!growTokens(a, (int)(len / 4) + 16))
+        return -1;
+    do
+    {
+        int i = a->count;
+        if (i == a->cap && !growTokens(a, a->cap * 2))
+            return -1;
+        type = getTokenWith(ps);
+        a->types[i] = (unsigned char)type;
+        a->offsets[i] = (int)(ps->tokenStart - ps->spanBase);
+        a->lengths[i] = (int)(ps->tokenEnd - ps->tokenStart);
+        a->lines[i] = ps->lineno;
+        a->names[i] = type == ID ? ps->tokenName : NULL;
+        a->count++;
+    } while (type != ENDFILE);
+    return a->count;
+}
+
+/* Procedure freeTokenArray releases the arrays of
+ * tokens
+ */
+void freeTokenArray(TokenArray *a)
+{
+    free(a->types);
+    free(a->offsets);
+    free(a->lengths);
+    free(a->lines);
+    free(a->names);
+    memset(a, 0, sizeof(*a));
+}
+
+/* function getToken returns the
+ * next token in source file
+ */
+TokenType getToken(void)
+{
+    CMinusParser *ps = defaultParser();
+    TokenType currentToken = getTokenWith(ps);
+    /* callers may write to listing between tokens */
+    outFlush(&ps->out);
+    lineno = ps->lineno;
+    strcpy(tokenString, ps->tokenString);
+    tokenName = ps->tokenName;
     return currentToken;
-} /* end getToken */
+}
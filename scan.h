@@ -1,16 +1,91 @@
 #ifndef _SCAN_H_
 #define _SCAN_H_
 
-/* MAXTOKENLEN is the maximum size of a token */
-#define MAXTOKENLEN 40
-
-/* tokenString array stores the lexeme of each token */
+/* tokenString array stores the lexeme of each token
+ * read through getToken */
 extern char tokenString[MAXTOKENLEN + 1];
 
+/* tokenName is the interned lexeme of the last token
+ * read through getToken when it is an ID (see
+ * internName); it stays valid, and shared by every
+ * use of the same name, until freeTrees
+ */
+extern const char *tokenName;
+
 /*
  *function getToken returns the
  * next token in source file
  */
 TokenType getToken(void);
 
+/* function getTokenWith returns the
+ * next token in the parser's source file
+ */
+TokenType getTokenWith(CMinusParser *);
+
+/* Function nextTokenWith moves the parser's token
+ * stream on to the next token, scanning it unless it
+ * was peeked at already, and returns its type
+ */
+TokenType nextTokenWith(CMinusParser *);
+
+/* Function peekTokenWith returns the type of the k-th
+ * token after the current one in the parser's token
+ * stream, 0 < k < LOOKAHEAD, scanning up to it first
+ * if needed
+ */
+TokenType peekTokenWith(CMinusParser *, int k);
+
+/* currentToken is the record of the parser's current
+ * token; the stream must have been started with
+ * nextTokenWith
+ */
+#define currentToken(ps) (&(ps)->tokens[(ps)->tokenHead])
+
+/* Function tokenizeWith scans the parser's whole
+ * source into tokens, up to and including ENDFILE;
+ * returns the number of tokens, or -1 if memory is
+ * exhausted. Echo and trace output is written as the
+ * text is scanned.
+ */
+int tokenizeWith(CMinusParser *, TokenArray *tokens);
+
+/* Procedure freeTokenArray releases the arrays of
+ * tokens
+ */
+void freeTokenArray(TokenArray *tokens);
+
+/* Function sourceText returns the parser's whole
+ * source text, loading it if scanning has not begun,
+ * and stores its length in len
+ */
+const char *sourceText(CMinusParser *, size_t *len);
+
+/* Procedure setSourceText makes the parser scan the
+ * borrowed chars [text, end) instead of its source
+ * file. text lies within a larger buffer ending at
+ * textEnd, from which whole lines are echoed; lineno
+ * is the line text starts on, and when text starts
+ * mid-line that line counts as already read. Node
+ * spans are measured from text until spanBase is set
+ */
+void setSourceText(CMinusParser *, const char *text, const char *end, const char *textEnd, int lineno, int midLine);
+
+/* Procedure seekSource moves the scanner to pos, a
+ * token boundary on line lineno within the text being
+ * scanned, as if it had just read up to pos; tokens
+ * peeked at are dropped
+ */
+void seekSource(CMinusParser *, const char *pos, int lineno);
+
+/* Procedure closeSource releases the parser's
+ * source buffer
+ */
+void closeSource(CMinusParser *);
+
+/* function reservedLookup classifies the identifier
+ * s of length len as a reserved word or ID
+ */
+TokenType reservedLookup(const char *s, int len);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "scanfast.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+/****************************************/
+/*           scalar kernels             */
+/****************************************/
+
+static const char *skipSpacesScalar(const char *p, const char *end)
+{
+    while (p < end && IS_SPACE(*p))
+        p++;
+    return p;
+}
+
+static const char *skipLettersScalar(const char *p, const char *end)
+{
+    while (p < end && IS_LETTER(*p))
+        p++;
+    return p;
+}
+
+static const char *skipDigitsScalar(const char *p, const char *end)
+{
+    while (p < end && IS_DIGIT(*p))
+        p++;
+    return p;
+}
+
+static const char *findStarScalar(const char *p, const char *end)
+{
+    while (p < end && *p != '*')
+        p++;
+    return p;
+}
+
+const char *(*skipSpaces)(const char *, const char *) = skipSpacesScalar;
+const char *(*skipLetters)(const char *, const char *) = skipLettersScalar;
+const char *(*skipDigits)(const char *, const char *) = skipDigitsScalar;
+const char *(*findStar)(const char *, const char *) = findStarScalar;
+
+#ifdef HAVE_X86
+
+/* Each vector kernel builds a mask of the bytes that
+   continue the run; the first zero bit of that mask
+   is where the run ends. Ranges are tested with a
+   signed compare after biasing the range start down
+   to -128, since SSE2 has no unsigned byte compare. */
+
+/****************************************/
+/*            SSE2 kernels              */
+/****************************************/
+
+__attribute__((target("sse2"))) static const char *skipSpacesSSE2(const char *p, const char *end)
+{
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t');
+    const __m128i nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    while (end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (stop)
+            return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return skipSpacesScalar(p, end);
+}
+
+__attribute__((target("sse2"))) static const char *skipLettersSSE2(const char *p, const char *end)
+{
+    const __m128i lower = _mm_set1_epi8(0x20), bias = _mm_set1_epi8((char)(-128 - 'a'));
+    const __m128i limit = _mm_set1_epi8(-128 + 26);
+    while (end - p >= 16)
+    {
+        __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i *)p), lower);
+        __m128i m = _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit);
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (stop)
+            return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return skipLettersScalar(p, end);
+}
+
+__attribute__((target("sse2"))) static const char *skipDigitsSSE2(const char *p, const char *end)
+{
+    const __m128i bias = _mm_set1_epi8((char)(-128 - '0')), limit = _mm_set1_epi8(-128 + 10);
+    while (end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i m = _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit);
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(m) & 0xFFFF;
+        if (stop)
+            return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return skipDigitsScalar(p, end);
+}
+
+__attribute__((target("sse2"))) static const char *findStarSSE2(const char *p, const char *end)
+{
+    const __m128i star = _mm_set1_epi8('*');
+    while (end - p >= 16)
+    {
+        unsigned hit = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), star));
+        if (hit)
+            return p + __builtin_ctz(hit);
+        p += 16;
+    }
+    return findStarScalar(p, end);
+}
+
+/****************************************/
+/*            AVX2 kernels              */
+/****************************************/
+
+__attribute__((target("avx2"))) static const char *skipSpacesAVX2(const char *p, const char *end)
+{
+    const __m256i sp = _mm256_set1_epi8(' '), tab = _mm256_set1_epi8('\t');
+    const __m256i nl = _mm256_set1_epi8('\n'), cr = _mm256_set1_epi8('\r');
+    while (end - p >= 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, tab)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, nl), _mm256_cmpeq_epi8(v, cr)));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(m);
+        if (stop)
+            return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return skipSpacesSSE2(p, end);
+}
+
+__attribute__((target("avx2"))) static const char *skipLettersAVX2(const char *p, const char *end)
+{
+    const __m256i lower = _mm256_set1_epi8(0x20), bias = _mm256_set1_epi8((char)(-128 - 'a'));
+    const __m256i limit = _mm256_set1_epi8(-128 + 26);
+    while (end - p >= 32)
+    {
+        __m256i v = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)p), lower);
+        __m256i m = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(v, bias));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(m);
+        if (stop)
+            return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return skipLettersSSE2(p, end);
+}
+
+__attribute__((target("avx2"))) static const char *skipDigitsAVX2(const char *p, const char *end)
+{
+    const __m256i bias = _mm256_set1_epi8((char)(-128 - '0')), limit = _mm256_set1_epi8(-128 + 10);
+    while (end - p >= 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i m = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(v, bias));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(m);
+        if (stop)
+            return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return skipDigitsSSE2(p, end);
+}
+
+__attribute__((target("avx2"))) static const char *findStarAVX2(const char *p, const char *end)
+{
+    const __m256i star = _mm256_set1_epi8('*');
+    while (end - p >= 32)
+    {
+        unsigned hit = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), star));
+        if (hit)
+            return p + __builtin_ctz(hit);
+        p += 32;
+    }
+    return findStarSSE2(p, end);
+}
+
+#endif /* HAVE_X86 */
+
+/* Procedure initScanFast selects the widest kernels
+ * the running CPU supports
+ */
+void initScanFast(void)
+{
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        skipSpaces = skipSpacesAVX2;
+        skipLetters = skipLettersAVX2;
+        skipDigits = skipDigitsAVX2;
+        findStar = findStarAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        skipSpaces = skipSpacesSSE2;
+        skipLetters = skipLettersSSE2;
+        skipDigits = skipDigitsSSE2;
+        findStar = findStarSSE2;
+    }
+#endif
+}
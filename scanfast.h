@@ -0,0 +1,38 @@
+#ifndef _SCANFAST_H_
+#define _SCANFAST_H_
+
+/* Fast paths for the scanner's most common runs.
+ * Each function scans [p, end) and returns the first
+ * position that ends the run, or end if the run goes
+ * to the end of the range. They are function pointers
+ * so that initScanFast can pick SSE2 or AVX2 kernels
+ * at run time; until then the scalar versions are used.
+ */
+
+/* character tests shared by the kernels and the
+ * scanner; unlike isalpha and isdigit they take any
+ * char or EOF, negative or not, and do not depend on
+ * the locale
+ */
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+#define IS_LETTER(c) ((unsigned)(((c) | 0x20) - 'a') < 26)
+#define IS_DIGIT(c) ((unsigned)((c) - '0') < 10)
+
+/* skipSpaces skips blanks, tabs and line breaks */
+extern const char *(*skipSpaces)(const char *p, const char *end);
+
+/* skipLetters skips the letters of an identifier */
+extern const char *(*skipLetters)(const char *p, const char *end);
+
+/* skipDigits skips the digits of a number */
+extern const char *(*skipDigits)(const char *p, const char *end);
+
+/* findStar finds the next '*' inside a comment */
+extern const char *(*findStar)(const char *p, const char *end);
+
+/* Procedure initScanFast selects the widest kernels
+ * the running CPU supports
+ */
+void initScanFast(void);
+
+#endif
@@ -0,0 +1,202 @@
+#include "globals.h"
+#include "stats.h"
+
+#include <time.h>
+
+static const char *const phaseName[PHASES] = {
+    [ReadPhase] = "read",
+    [ScanPhase] = "scan",
+    [ParsePhase] = "parse",
+    [PrintPhase] = "print",
+    [AnalyzePhase] = "analyze",
+    [FoldPhase] = "fold",
+    [CompilePhase] = "compile",
+    [RunPhase] = "run",
+    [WritePhase] = "write",
+};
+
+static const char *const stmtName[STMTKINDS] = {
+    [IfK] = "IfK",
+    [WhileK] = "WhileK",
+    [ReturnK] = "ReturnK",
+    [AssignK] = "AssignK",
+    [ParamsK] = "ParamsK",
+    [ParamK] = "ParamK",
+    [FuncK] = "FuncK",
+    [Var_DeclK] = "Var_DeclK",
+    [CompK] = "CompK",
+};
+
+static const char *const expName[EXPKINDS] = {
+    [OpK] = "OpK",
+    [ConstK] = "ConstK",
+    [IdK] = "IdK",
+    [IntK] = "IntK",
+    [VoidK] = "VoidK",
+    [Arry_ElemK] = "Arry_ElemK",
+    [CallK] = "CallK",
+    [Arry_DeclK] = "Arry_DeclK",
+    [ArgsK] = "ArgsK",
+};
+
+static double millis(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* Procedure startPhase starts timing a phase; the
+ * times of several runs of a phase add up
+ */
+void startPhase(RunStats *s, Phase phase)
+{
+    if (s == NULL)
+        return;
+    s->current = phase;
+    s->timed[phase] = TRUE;
+    s->startWall = millis(CLOCK_MONOTONIC);
+    s->startCpu = millis(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+/* Procedure endPhase stops timing the current phase */
+void endPhase(RunStats *s)
+{
+    if (s == NULL)
+        return;
+    s->wall[s->current] += millis(CLOCK_MONOTONIC) - s->startWall;
+    s->cpu[s->current] += millis(CLOCK_PROCESS_CPUTIME_ID) - s->startCpu;
+}
+
+/* Procedure addParseStats adds the counters of src
+ * to those of dst
+ */
+void addParseStats(ParseStats *dst, const ParseStats *src)
+{
+    int k;
+    dst->tokens += src->tokens;
+    for (k = 0; k < STMTKINDS; k++)
+        dst->stmtNodes[k] += src->stmtNodes[k];
+    for (k = 0; k < EXPKINDS; k++)
+        dst->expNodes[k] += src->expNodes[k];
+}
+
+static long totalNodes(const ParseStats *c)
+{
+    long n = 0;
+    int k;
+    for (k = 0; k < STMTKINDS; k++)
+        n += c->stmtNodes[k];
+    for (k = 0; k < EXPKINDS; k++)
+        n += c->expNodes[k];
+    return n;
+}
+
+/* scanMillis is the time tokens and bytes are rated
+   by: the scan pass when there was one, else the
+   parse that scanned along */
+static double scanMillis(const RunStats *s)
+{
+    return s->timed[ScanPhase] ? s->wall[ScanPhase] : s->wall[ParsePhase];
+}
+
+static double perSecond(double count, double ms)
+{
+    return ms > 0 ? count * 1e3 / ms : 0;
+}
+
+/* jsonString writes s as a JSON string */
+static void jsonString(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s != '\0'; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void printJson(const RunStats *s, FILE *f)
+{
+    const ParseStats *c = &s->counts;
+    double ms = scanMillis(s);
+    int p, k;
+    fprintf(f, "{\n  \"file\": ");
+    jsonString(f, s->name != NULL ? s->name : "");
+    fprintf(f, ",\n  \"cached\": %s,\n  \"phases\": {", s->cached ? "true" : "false");
+    for (p = 0; p < PHASES; p++)
+    {
+        fprintf(f, "%s\n    \"%s\": ", p > 0 ? "," : "", phaseName[p]);
+        if (s->timed[p])
+            fprintf(f, "{\"wall_ms\": %.3f, \"cpu_ms\": %.3f}", s->wall[p], s->cpu[p]);
+        else
+            fprintf(f, "null");
+    }
+    fprintf(f, "\n  },\n");
+    fprintf(f, "  \"tokens\": %ld,\n  \"tokens_per_sec\": %.0f,\n",
+            c->tokens, perSecond(c->tokens, ms));
+    fprintf(f, "  \"bytes\": %zu,\n  \"bytes_per_sec\": %.0f,\n",
+            s->sourceBytes, perSecond(s->sourceBytes, ms));
+    fprintf(f, "  \"syntax_errors\": %d,\n  \"semantic_errors\": %d,\n", s->errors, s->semanticErrors);
+    fprintf(f, "  \"nodes_folded\": %d,\n", s->folded);
+    fprintf(f, "  \"tree_bytes\": %zu,\n  \"compact_bytes\": %zu,\n",
+            s->treeBytes, s->compactBytes);
+    fprintf(f, "  \"nodes\": {\n    \"total\": %ld,\n    \"stmt\": {", totalNodes(c));
+    for (k = 0; k < STMTKINDS; k++)
+        fprintf(f, "%s\"%s\": %ld", k > 0 ? ", " : "", stmtName[k], c->stmtNodes[k]);
+    fprintf(f, "},\n    \"exp\": {");
+    for (k = 0; k < EXPKINDS; k++)
+        fprintf(f, "%s\"%s\": %ld", k > 0 ? ", " : "", expName[k], c->expNodes[k]);
+    fprintf(f, "}\n  }\n}\n");
+}
+
+static void printText(const RunStats *s, FILE *f)
+{
+    const ParseStats *c = &s->counts;
+    double ms = scanMillis(s), wall = 0, cpu = 0;
+    int p, k;
+    fprintf(f, "%s%s\n", s->name != NULL ? s->name : "", s->cached ? " (from cache)" : "");
+    fprintf(f, "  phase         wall ms     cpu ms\n");
+    for (p = 0; p < PHASES; p++)
+        if (s->timed[p])
+        {
+            fprintf(f, "  %-7s %12.3f %10.3f%s\n", phaseName[p], s->wall[p], s->cpu[p],
+                    p == ParsePhase && !s->timed[ScanPhase] && !s->cached ? "  (scan included)" : "");
+            wall += s->wall[p];
+            cpu += s->cpu[p];
+        }
+    fprintf(f, "  %-7s %12.3f %10.3f\n", "total", wall, cpu);
+    fprintf(f, "  tokens         %10ld  (%.0f/s)\n", c->tokens, perSecond(c->tokens, ms));
+    fprintf(f, "  bytes          %10zu  (%.1f MB/s)\n", s->sourceBytes,
+            perSecond(s->sourceBytes, ms) / (1024 * 1024));
+    fprintf(f, "  syntax errors  %10d\n", s->errors);
+    fprintf(f, "  semantic errors %9d\n", s->semanticErrors);
+    if (s->timed[FoldPhase])
+        fprintf(f, "  nodes folded   %10d\n", s->folded);
+    fprintf(f, "  tree memory    %10zu bytes", s->treeBytes);
+    if (s->compactBytes > 0)
+        fprintf(f, " (compact %zu)", s->compactBytes);
+    fprintf(f, "\n  nodes          %10ld\n", totalNodes(c));
+    for (k = 0; k < STMTKINDS; k++)
+        if (c->stmtNodes[k] > 0)
+            fprintf(f, "    %-10s   %10ld\n", stmtName[k], c->stmtNodes[k]);
+    for (k = 0; k < EXPKINDS; k++)
+        if (c->expNodes[k] > 0)
+            fprintf(f, "    %-10s   %10ld\n", expName[k], c->expNodes[k]);
+}
+
+/* Procedure printStats writes the report to f, as a
+ * JSON object with json set and as text otherwise
+ */
+void printStats(const RunStats *s, FILE *f, int json)
+{
+    if (json)
+        printJson(s, f);
+    else
+        printText(s, f);
+}
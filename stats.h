@@ -0,0 +1,63 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/* RunStats collects what --stats reports about one
+ * run: the wall and CPU time of each phase, the
+ * parser's counters, and the size of the input and
+ * of its syntax tree. Nothing is timed or counted
+ * unless --stats is given: the phase procedures do
+ * nothing on a NULL RunStats, and a parser counts
+ * only while its stats pointer is set.
+ */
+
+typedef enum
+{
+    ReadPhase,    /* loading the source text */
+    ScanPhase,    /* the scan pass of --pretokenize */
+    ParsePhase,   /* parsing; scanning too in one-pass mode */
+    PrintPhase,   /* printing the syntax tree */
+    AnalyzePhase, /* resolving names and checking types */
+    FoldPhase,    /* folding constants, with --fold */
+    CompilePhase, /* compiling it to bytecode, with --vm or --disasm */
+    RunPhase,     /* running the program, with --run or --vm */
+    WritePhase,   /* writing the listing, AST file and cache */
+    PHASES
+} Phase;
+
+typedef struct
+{
+    const char *name;             /* source file name */
+    double wall[PHASES];          /* milliseconds spent in each phase */
+    double cpu[PHASES];           /* CPU milliseconds, of all threads */
+    int timed[PHASES];            /* phases that were entered */
+    Phase current;                /* phase being timed */
+    double startWall, startCpu;   /* when it started */
+    ParseStats counts;
+    size_t sourceBytes;
+    size_t treeBytes;    /* arena bytes of the syntax tree */
+    size_t compactBytes; /* bytes of its CompactAst, 0 if none */
+    int errors;          /* syntax errors */
+    int semanticErrors;  /* found by analyze, if it ran */
+    int folded;          /* nodes eliminated by --fold, or -1 */
+    int cached;          /* answered from the cache */
+} RunStats;
+
+/* Procedure startPhase starts timing a phase; the
+ * times of several runs of a phase add up
+ */
+void startPhase(RunStats *, Phase);
+
+/* Procedure endPhase stops timing the current phase */
+void endPhase(RunStats *);
+
+/* Procedure addParseStats adds the counters of src
+ * to those of dst
+ */
+void addParseStats(ParseStats *dst, const ParseStats *src);
+
+/* Procedure printStats writes the report to f, as a
+ * JSON object with json set and as text otherwise
+ */
+void printStats(const RunStats *, FILE *f, int json);
+
+#endif
@@ -0,0 +1,133 @@
+#include "globals.h"
+#include "symtab.h"
+
+/* findSlot returns the slot of name, or the empty slot
+   it would go in; names are interned, so the pointer
+   is the key */
+static unsigned findSlot(const SymTab *tab, const char *name)
+{
+    unsigned mask = tab->slotCap - 1;
+    unsigned h = (unsigned)(((size_t)name >> 3) * 2654435761u) & mask;
+    while (tab->slots[h].name != NULL && tab->slots[h].name != name)
+        h = (h + 1) & mask;
+    return h;
+}
+
+/* growSlots doubles the hash table, keeping it at
+   most half full */
+static int growSlots(SymTab *tab)
+{
+    SymTab grown = *tab;
+    unsigned i;
+    grown.slotCap = tab->slotCap ? tab->slotCap * 2 : 256;
+    grown.slots = calloc(grown.slotCap, sizeof(SymSlot));
+    if (grown.slots == NULL)
+        return FALSE;
+    for (i = 0; i < tab->slotCap; i++)
+        if (tab->slots[i].name != NULL)
+            grown.slots[findSlot(&grown, tab->slots[i].name)] = tab->slots[i];
+    free(tab->slots);
+    tab->slots = grown.slots;
+    tab->slotCap = grown.slotCap;
+    return TRUE;
+}
+
+/* Procedure initSymTab makes an empty table with
+ * only the global scope open
+ */
+void initSymTab(SymTab *tab)
+{
+    memset(tab, 0, sizeof(*tab));
+}
+
+/* Procedure freeSymTab releases the table's memory */
+void freeSymTab(SymTab *tab)
+{
+    free(tab->slots);
+    free(tab->symbols);
+    free(tab->scopes);
+    initSymTab(tab);
+}
+
+/* Function pushScope opens a scope inside the current
+ * one; FALSE if memory is exhausted
+ */
+int pushScope(SymTab *tab)
+{
+    if (tab->level == tab->scopeCap)
+    {
+        int cap = tab->scopeCap ? tab->scopeCap * 2 : 64;
+        int *grown = realloc(tab->scopes, cap * sizeof(int));
+        if (grown == NULL)
+            return FALSE;
+        tab->scopes = grown;
+        tab->scopeCap = cap;
+    }
+    tab->scopes[tab->level++] = tab->count;
+    return TRUE;
+}
+
+/* Procedure popScope closes the innermost scope,
+ * dropping the names declared in it
+ */
+void popScope(SymTab *tab)
+{
+    int mark;
+    if (tab->level == 0)
+        return;
+    mark = tab->scopes[--tab->level];
+    while (tab->count > mark)
+    {
+        const Symbol *s = &tab->symbols[--tab->count];
+        tab->slots[findSlot(tab, s->name)].symbol = s->shadowed;
+    }
+}
+
+/* Function declareSymbol enters name, declared by
+ * decl, in the innermost scope and returns its symbol;
+ * the symbol already there if the scope has the name
+ */
+Symbol *declareSymbol(SymTab *tab, const char *name, TreeNode *decl)
+{
+    SymSlot *slot;
+    Symbol *s;
+    if (2 * (tab->nameCount + 1) > tab->slotCap && !growSlots(tab))
+        return NULL;
+    slot = &tab->slots[findSlot(tab, name)];
+    if (slot->name == NULL)
+    {
+        slot->name = name;
+        slot->symbol = -1;
+        tab->nameCount++;
+    }
+    if (slot->symbol >= 0 && tab->symbols[slot->symbol].level == tab->level)
+        return &tab->symbols[slot->symbol];
+    if (tab->count == tab->cap)
+    {
+        int cap = tab->cap ? tab->cap * 2 : 256;
+        Symbol *grown = realloc(tab->symbols, cap * sizeof(Symbol));
+        if (grown == NULL)
+            return NULL;
+        tab->symbols = grown;
+        tab->cap = cap;
+    }
+    s = &tab->symbols[tab->count];
+    s->name = name;
+    s->decl = decl;
+    s->level = tab->level;
+    s->shadowed = slot->symbol;
+    slot->symbol = tab->count++;
+    return s;
+}
+
+/* Function lookupSymbol returns the innermost symbol
+ * of name in scope, or NULL
+ */
+Symbol *lookupSymbol(const SymTab *tab, const char *name)
+{
+    const SymSlot *slot;
+    if (tab->slotCap == 0)
+        return NULL;
+    slot = &tab->slots[findSlot(tab, name)];
+    return slot->name != NULL && slot->symbol >= 0 ? &tab->symbols[slot->symbol] : NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef _SYMTAB_H_
+#define _SYMTAB_H_
+
+/* A SymTab maps names to their declarations in nested
+ * scopes. Every name has one slot in an open-addressing
+ * hash table, keyed by its interned pointer, holding the
+ * innermost symbol of that name; each symbol remembers
+ * the one it shadows. Symbols are kept on a stack in
+ * the order they are declared, so opening a scope only
+ * records the height of the stack, and closing it hands
+ * each name declared since back to the symbol it hid:
+ * every declaration is entered and removed once, in
+ * constant expected time, however many there are.
+ */
+
+typedef struct
+{
+    const char *name;
+    TreeNode *decl; /* Var_DeclK, ParamK or FuncK */
+    int level;      /* scope depth, 0 for the globals */
+    int shadowed;   /* symbol of the same name it hides, or -1 */
+} Symbol;
+
+/* a hash table slot: a name and its innermost symbol,
+   -1 while none is in scope */
+typedef struct
+{
+    const char *name;
+    int symbol;
+} SymSlot;
+
+typedef struct
+{
+    SymSlot *slots;
+    unsigned slotCap;   /* a power of two */
+    unsigned nameCount; /* slots in use */
+    Symbol *symbols;    /* the symbol stack */
+    int count, cap;
+    int *scopes; /* stack height at each open scope */
+    int level, scopeCap;
+} SymTab;
+
+/* Procedure initSymTab makes an empty table with
+ * only the global scope open
+ */
+void initSymTab(SymTab *);
+
+/* Procedure freeSymTab releases the table's memory */
+void freeSymTab(SymTab *);
+
+/* Function pushScope opens a scope inside the current
+ * one; FALSE if memory is exhausted
+ */
+int pushScope(SymTab *);
+
+/* Procedure popScope closes the innermost scope,
+ * dropping the names declared in it
+ */
+void popScope(SymTab *);
+
+/* Function declareSymbol enters name, declared by
+ * decl, in the innermost scope and returns its symbol.
+ * If the scope already has that name, the symbol found
+ * there is returned unchanged. NULL if memory is
+ * exhausted. Symbols move as the table grows, so the
+ * pointer is only good until the next declaration
+ */
+Symbol *declareSymbol(SymTab *, const char *name, TreeNode *decl);
+
+/* Function lookupSymbol returns the innermost symbol
+ * of name in scope, or NULL
+ */
+Symbol *lookupSymbol(const SymTab *, const char *name);
+
+#endif
@@ -1,11 +1,40 @@
 #include "globals.h"
 #include "util.h"
+#include "parse.h"
+#include "scan.h"
+#include "walk.h"
 
-/* Procedure printToken prints a token
- * and its lexeme to the listing file
+/* listing text of the tokens whose spelling is fixed;
+   NULL for the ones printed with their lexeme */
+static const char *const tokenText[] = {
+    [ENDFILE] = "EOF\n",
+    [ASSIGN] = "=\n",
+    [EQ] = "==\n",
+    [NEQ] = "~=\n",
+    [LT] = "<\n",
+    [LE] = "<=\n",
+    [GT] = ">\n",
+    [GE] = ">=\n",
+    [PLUS] = "+\n",
+    [MINUS] = "-\n",
+    [TIMES] = "*\n",
+    [OVER] = "/\n",
+    [LPAREN] = "(\n",
+    [RPAREN] = ")\n",
+    [LBRACKET] = "[\n",
+    [RBRACKET] = "]\n",
+    [LBRACE] = "{\n",
+    [RBRACE] = "}\n",
+    [SEMI] = ";\n",
+    [COMMA] = ",\n",
+};
+
+/* Procedure printTokenWith prints a token
+ * and its lexeme to the parser's listing file
  */
-void printToken(TokenType token, const char *tokenString)
+void printTokenWith(CMinusParser *ps, TokenType token, const char *tokenString)
 {
+    OutBuf *out = &ps->out;
     switch (token)
     {
     case IF:
@@ -14,95 +43,60 @@ void printToken(TokenType token, const char *tokenString)
     case RETURN:
     case VOID:
     case WHILE:
-        fprintf(listing,
-                "reserved word: %s\n", tokenString);
-        break;
-    case COMMA:
-        fprintf(listing, ",\n");
-        break;
-    case ASSIGN:
-        fprintf(listing, "=\n");
-        break;
-    case LT:
-        fprintf(listing, "<\n");
-        break;
-    case LE:
-        fprintf(listing, "<=\n");
-        break;
-    case GT:
-        fprintf(listing, ">\n");
-        break;
-    case GE:
-        fprintf(listing, ">=\n");
-        break;
-    case EQ:
-        fprintf(listing, "==\n");
-        break;
-    case NEQ:
-        fprintf(listing, "~=\n");
-        break;
-    case LPAREN:
-        fprintf(listing, "(\n");
-        break;
-    case RPAREN:
-        fprintf(listing, ")\n");
-        break;
-    case SEMI:
-        fprintf(listing, ";\n");
-        break;
-    case PLUS:
-        fprintf(listing, "+\n");
-        break;
-    case MINUS:
-        fprintf(listing, "-\n");
-        break;
-    case TIMES:
-        fprintf(listing, "*\n");
-        break;
-    case OVER:
-        fprintf(listing, "/\n");
-        break;
-    case ENDFILE:
-        fprintf(listing, "EOF\n");
-        break;
-    case LBRACKET:
-        fprintf(listing, "[\n");
-        break;
-    case RBRACKET:
-        fprintf(listing, "]\n");
-        break;
-    case LBRACE:
-        fprintf(listing, "{\n");
-        break;
-    case RBRACE:
-        fprintf(listing, "}\n");
+        outStr(out, "reserved word: ");
+        outStr(out, tokenString);
+        outChar(out, '\n');
         break;
     case NUM:
-        fprintf(listing,
-                "NUM, val= %s\n", tokenString);
+        outStr(out, "NUM, val= ");
+        outStr(out, tokenString);
+        outChar(out, '\n');
         break;
     case ID:
-        fprintf(listing,
-                "ID, name= %s\n", tokenString);
+        outStr(out, "ID, name= ");
+        outStr(out, tokenString);
+        outChar(out, '\n');
         break;
     case ERROR:
-        fprintf(listing,
-                "ERROR: %s    %s\n", tokenString, "2019141460148王世杰");
+        outStr(out, "ERROR: ");
+        outStr(out, tokenString);
+        outStr(out, "    2019141460148王世杰\n");
         break;
-    default: /* should never happen */
-        fprintf(listing, "Unknown token: %d\n", token);
+    default:
+        if ((unsigned)token < sizeof(tokenText) / sizeof(tokenText[0]) && tokenText[token] != NULL)
+            outStr(out, tokenText[token]);
+        else /* should never happen */
+            outPrintf(out, "Unknown token: %d\n", token);
     }
 }
 
-/* Function newStmtNode creates a new statement
- * node for syntax tree construction
+/* Procedure printToken prints a token
+ * and its lexeme to the listing file
  */
-TreeNode *newStmtNode(StmtKind kind)
+void printToken(TokenType token, const char *tokenString)
+{
+    CMinusParser *ps = defaultParser();
+    printTokenWith(ps, token, tokenString);
+    outFlush(&ps->out);
+}
+
+/* nodeLine returns the line a new node is on: that
+   of the current token while parsing, which may lie
+   behind the tokens scanned ahead */
+static int nodeLine(CMinusParser *ps)
+{
+    return ps->tokenCount > 0 ? currentToken(ps)->lineno : ps->lineno;
+}
+
+/* Function newStmtNodeWith creates a new statement
+ * node in the parser's arena
+ */
+TreeNode *newStmtNodeWith(CMinusParser *ps, StmtKind kind)
 {
-    TreeNode *t = (TreeNode *)malloc(sizeof(TreeNode));
+    TreeNode *t = (TreeNode *)arenaAlloc(&ps->arena, sizeof(TreeNode));
     int i;
     if (t == NULL)
-        fprintf(listing, "Out of memory error at line %d\n", lineno);
+        outPrintf(&ps->out, "Out of memory error at line %d\n", nodeLine(ps));
     else
     {
         for (i = 0; i < MAXCHILDREN; i++)
@@ -110,20 +104,35 @@ TreeNode *newStmtNode(StmtKind kind)
         t->sibling = NULL;
         t->nodekind = StmtK;
         t->kind.stmt = kind;
-        t->lineno = lineno;
+        if (ps->stats != NULL)
+            ps->stats->stmtNodes[kind]++;
+        t->attr.name = NULL;
+        t->lineno = nodeLine(ps);
+        t->start = t->end = -1;
+        t->decl = NULL;
+        t->type = Void;
+        t->slot = 0;
     }
     return t;
 }
 
-/* Function newExpNode creates a new expression
+/* Function newStmtNode creates a new statement
  * node for syntax tree construction
  */
-TreeNode *newExpNode(ExpKind kind)
+TreeNode *newStmtNode(StmtKind kind)
+{
+    return newStmtNodeWith(defaultParser(), kind);
+}
+
+/* Function newExpNodeWith creates a new expression
+ * node in the parser's arena
+ */
+TreeNode *newExpNodeWith(CMinusParser *ps, ExpKind kind)
 {
-    TreeNode *t = (TreeNode *)malloc(sizeof(TreeNode));
+    TreeNode *t = (TreeNode *)arenaAlloc(&ps->arena, sizeof(TreeNode));
     int i;
     if (t == NULL)
-        fprintf(listing, "Out of memory error at line %d\n", lineno);
+        outPrintf(&ps->out, "Out of memory error at line %d\n", nodeLine(ps));
     else
     {
         for (i = 0; i < MAXCHILDREN; i++)
@@ -131,12 +140,26 @@ TreeNode *newExpNode(ExpKind kind)
         t->sibling = NULL;
         t->nodekind = ExpK;
         t->kind.exp = kind;
-        t->lineno = lineno;
-        // t->type = Void;
+        if (ps->stats != NULL)
+            ps->stats->expNodes[kind]++;
+        t->attr.name = NULL;
+        t->lineno = nodeLine(ps);
+        t->start = t->end = -1;
+        t->decl = NULL;
+        t->type = Void;
+        t->slot = 0;
     }
     return t;
 }
 
+/* Function newExpNode creates a new expression
+ * node for syntax tree construction
+ */
+TreeNode *newExpNode(ExpKind kind)
+{
+    return newExpNodeWith(defaultParser(), kind);
+}
+
 /* Function copyString allocates and makes a new
  * copy of an existing string
  */
@@ -147,14 +170,52 @@ char *copyString(char *s)
     if (s == NULL)
         return NULL;
     n = strlen(s) + 1;
-    t = malloc(n);
+    t = arenaAlloc(&defaultParser()->arena, n);
     if (t == NULL)
-        fprintf(listing, "Out of memory error at line %d\n", lineno);
+        outPrintf(&defaultParser()->out, "Out of memory error at line %d\n", lineno);
     else
         strcpy(t, s);
     return t;
 }
 
+/* Function internNameWith returns the parser's
+ * single shared copy of the len chars at s
+ */
+const char *internNameWith(CMinusParser *ps, const char *s, int len)
+{
+    const char *name = internString(&ps->names, &ps->arena, s, len);
+    if (name == NULL)
+        outPrintf(&ps->out, "Out of memory error at line %d\n", ps->lineno);
+    return name;
+}
+
+/* Function internName returns the single shared
+ * copy of the len chars at s; equal names always
+ * get the same pointer until freeTrees
+ */
+const char *internName(const char *s, int len)
+{
+    return internNameWith(defaultParser(), s, len);
+}
+
+/* Procedure freeTreesWith releases every syntax tree
+ * node and name the parser has built so far
+ */
+void freeTreesWith(CMinusParser *ps)
+{
+    clearInternTable(&ps->names);
+    freeArena(&ps->arena);
+}
+
+/* Procedure freeTrees releases every syntax tree
+ * node and name built so far in one call; trees
+ * returned earlier by parse must not be used after
+ */
+void freeTrees(void)
+{
+    freeTreesWith(defaultParser());
+}
+
 /* see if next token is relop
  */
 int relop(TokenType token)
@@ -165,108 +226,102 @@ int relop(TokenType token)
         return 0;
 }
 
-/* Variable indentno is used by printTree to
- * store current number of spaces to indent
+/* the parser's indentno is used by printTreeWith
+ * as the number of spaces to indent the top of the
+ * tree by, less one indentation step
  */
-static int indentno = 0;
 
-/* macros to increase/decrease indentation */
-#define INDENT indentno += 2
-#define UNINDENT indentno -= 2
+/* spaces to indent by per level of the tree */
+#define INDENT_STEP 2
 
-/* printSpaces indents by printing spaces */
-static void printSpaces(void)
-{
-    int i;
-    for (i = 0; i < indentno; i++)
-        fprintf(listing, " ");
-}
+/* listing text of each statement and expression
+   node kind */
+static const char *const stmtText[] = {
+    [IfK] = "If\n",
+    [WhileK] = "while\n",
+    [ReturnK] = "Return\n",
+    [AssignK] = "Assign\n",
+    [ParamK] = "ParamK\n",
+    [ParamsK] = "ParamsK\n",
+    [FuncK] = "FuncK\n",
+    [Var_DeclK] = "Var_DeclK\n",
+    [CompK] = "Compk\n",
+};
 
-void printTree(TreeNode *tree)
+static const char *const expText[] = {
+    [OpK] = "Op: ",
+    [ConstK] = "ConstK: ",
+    [IdK] = "IdK: ",
+    [IntK] = "IntK\n",
+    [VoidK] = "VoidK\n",
+    [Arry_ElemK] = "Arry_ElemK\n",
+    [CallK] = "CallK\n",
+    [Arry_DeclK] = "Arry_DeclK\n",
+    [ArgsK] = "Argsk\n",
+};
+
+#define KNOWN(table, k) \
+    ((unsigned)(k) < sizeof(table) / sizeof(table[0]) && table[k] != NULL)
+
+/* printNode prints one node of the tree indented by
+   its depth, without flushing */
+static int printNode(TreeNode *tree, const WalkPos *pos, void *arg)
 {
-    int i;
-    INDENT;
-    while (tree != NULL)
+    CMinusParser *ps = arg;
+    OutBuf *out = &ps->out;
+    outSpaces(out, ps->indentno + INDENT_STEP * (pos->depth + 1));
+    if (tree->nodekind == StmtK)
     {
-        printSpaces();
-        if (tree->nodekind == StmtK)
-        {
-            switch (tree->kind.stmt)
-            {
-            case IfK:
-                fprintf(listing, "If\n");
-                break;
-            case WhileK:
-                fprintf(listing, "while\n");
-                break;
-            case ReturnK:
-                fprintf(listing, "Return\n");
-                break;
-            case AssignK:
-                fprintf(listing, "Assign\n");
-                break;
-            case ParamK:
-                fprintf(listing, "ParamK\n");
-                break;
-            case ParamsK:
-                fprintf(listing, "ParamsK\n");
-                break;
-            case FuncK:
-                fprintf(listing, "FuncK\n");
-                break;
-            case Var_DeclK:
-                fprintf(listing, "Var_DeclK\n");
-                break;
-            case CompK:
-                fprintf(listing, "Compk\n");
-                break;
-            default:
-                fprintf(listing, "Unknown ExpNode kind\n");
-                break;
-            }
-        }
-        else if (tree->nodekind == ExpK)
+        if (KNOWN(stmtText, tree->kind.stmt))
+            outStr(out, stmtText[tree->kind.stmt]);
+        else
+            outStr(out, "Unknown ExpNode kind\n");
+    }
+    else if (tree->nodekind == ExpK)
+    {
+        if (KNOWN(expText, tree->kind.exp))
         {
+            outStr(out, expText[tree->kind.exp]);
             switch (tree->kind.exp)
             {
             case OpK:
-                fprintf(listing, "Op: ");
-                printToken(tree->attr.op, "\0");
+                printTokenWith(ps, tree->attr.op, "\0");
                 break;
             case ConstK:
-                fprintf(listing, "ConstK: %d\n", tree->attr.val);
+                outInt(out, tree->attr.val, 0);
+                outChar(out, '\n');
                 break;
             case IdK:
-                fprintf(listing, "IdK: %s\n", tree->attr.name);
-                break;
-            case IntK:
-                fprintf(listing, "IntK\n");
-                break;
-            case VoidK:
-                fprintf(listing, "VoidK\n");
-                break;
-            case Arry_ElemK:
-                fprintf(listing, "Arry_ElemK\n");
-                break;
-            case CallK:
-                fprintf(listing, "CallK\n");
-                break;
-            case Arry_DeclK:
-                fprintf(listing, "Arry_DeclK\n");
-                break;
-            case ArgsK:
-                fprintf(listing, "Argsk\n");
+                outStr(out, tree->attr.name != NULL ? tree->attr.name : "(null)");
+                outChar(out, '\n');
                 break;
             default:
-                fprintf(listing, "Unknown ExpNode kind\n");
                 break;
             }
         }
         else
-            fprintf(listing, "Unknown node kind\n");
-        for (i = 0; i < MAXCHILDREN; i++)
-            printTree(tree->child[i]);
-        tree = tree->sibling;
+            outStr(out, "Unknown ExpNode kind\n");
     }
-    UNINDENT;
-}
\ No newline at end of file
+    else
+        outStr(out, "Unknown node kind\n");
+    return WALK_CONTINUE;
+}
+
+/* procedure printTreeWith prints a syntax tree to the
+ * parser's listing file using indentation to indicate
+ * subtrees
+ */
+void printTreeWith(CMinusParser *ps, TreeNode *tree)
+{
+    if (walkTree(tree, printNode, NULL, ps) < 0)
+        outStr(&ps->out, "Out of memory error printing tree\n");
+    outFlush(&ps->out);
+}
+
+/* procedure printTree prints a syntax tree to the
+ * listing file using indentation to indicate subtrees
+ */
+void printTree(TreeNode *tree)
+{
+    printTreeWith(defaultParser(), tree);
+}
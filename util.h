@@ -5,6 +5,12 @@
  * and its lexeme to the listing file
  */
 void printToken(TokenType, const char *);
+
+/* Procedure printTokenWith prints a token
+ * and its lexeme to the parser's listing file
+ */
+void printTokenWith(CMinusParser *, TokenType, const char *);
+
 /* Function newStmtNode creates a new statement
  * node for syntax tree construction
  */
@@ -15,11 +21,39 @@ TreeNode *newStmtNode(StmtKind);
  */
 TreeNode *newExpNode(ExpKind);
 
+/* Functions newStmtNodeWith and newExpNodeWith
+ * create new nodes in the parser's arena
+ */
+TreeNode *newStmtNodeWith(CMinusParser *, StmtKind);
+TreeNode *newExpNodeWith(CMinusParser *, ExpKind);
+
 /* Function copyString allocates and makes a new
  * copy of an existing string
  */
 char *copyString(char *);
 
+/* Function internName returns the single shared
+ * copy of the len chars at s; equal names always
+ * get the same pointer until freeTrees
+ */
+const char *internName(const char *s, int len);
+
+/* Function internNameWith returns the parser's
+ * single shared copy of the len chars at s
+ */
+const char *internNameWith(CMinusParser *, const char *s, int len);
+
+/* Procedure freeTrees releases every syntax tree
+ * node and name built so far in one call; trees
+ * returned earlier by parse must not be used after
+ */
+void freeTrees(void);
+
+/* Procedure freeTreesWith releases every syntax tree
+ * node and name the parser has built so far
+ */
+void freeTreesWith(CMinusParser *);
+
 /* see if next token is relop
  */
 int relop(TokenType);
@@ -29,4 +63,10 @@ int relop(TokenType);
  */
 void printTree(TreeNode *);
 
+/* procedure printTreeWith prints a syntax tree to the
+ * parser's listing file using indentation to indicate
+ * subtrees
+ */
+void printTreeWith(CMinusParser *, TreeNode *);
+
 #endif
\ No newline at end of file
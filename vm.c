@@ -0,0 +1,332 @@
+#include "globals.h"
+#include "interp.h"
+#include "vm.h"
+
+#include <limits.h>
+#include <stdarg.h>
+
+/* a call in progress */
+typedef struct
+{
+    const int *ret; /* instruction after the call */
+    int *regs;      /* the caller's registers */
+    int dst;        /* caller's register for the value */
+} VmFrame;
+
+static const char *declName(const TreeNode *decl)
+{
+    const TreeNode *id = decl->child[1];
+    return id->kind.exp == Arry_DeclK ? id->child[0]->attr.name : id->attr.name;
+}
+
+/* vmError reports an error at the instruction at pc
+   as interp does at the node it was compiled from */
+static void vmError(const Bytecode *bc, const int *pc, const char *format, ...)
+{
+    const TreeNode *t = bc->where[pc - bc->code];
+    va_list args;
+    fprintf(stderr, "Runtime error at line %d: ", t->lineno);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+/* the dispatch of one instruction to the next: a jump
+   through a table of label addresses where GCC's
+   computed goto is there, else a switch */
+#if defined(__GNUC__) && !defined(VM_SWITCH)
+#define VM_LABELS 1
+#define CASE(op) L_##op
+#define NEXT goto *labels[*pc]
+#define SWITCH_BEGIN
+#define SWITCH_END
+#else
+#define CASE(op) case op
+#define NEXT goto dispatch
+#define SWITCH_BEGIN dispatch: switch (*pc) {
+#define SWITCH_END }
+#endif
+
+#define WRAP(x, op, y) ((int)((unsigned)(x) op (unsigned)(y)))
+
+/* Function runBytecode runs compiled code as
+ * runProgram runs the tree (see interp.h), with the
+ * same memory, input and output and runtime errors;
+ * 0 when main returns, 1 after a runtime error
+ */
+int runBytecode(const Bytecode *bc, FILE *in, FILE *out)
+{
+#ifdef VM_LABELS
+    static const void *const labels[OPCODES] = {
+        [OP_HALT] = &&L_OP_HALT, [OP_KONST] = &&L_OP_KONST, [OP_MOVE] = &&L_OP_MOVE,
+        [OP_GETG] = &&L_OP_GETG, [OP_SETG] = &&L_OP_SETG, [OP_ADDR] = &&L_OP_ADDR,
+        [OP_ADD] = &&L_OP_ADD, [OP_SUB] = &&L_OP_SUB, [OP_MUL] = &&L_OP_MUL,
+        [OP_DIV] = &&L_OP_DIV, [OP_ADDK] = &&L_OP_ADDK, [OP_SUBK] = &&L_OP_SUBK,
+        [OP_MULK] = &&L_OP_MULK, [OP_DIVK] = &&L_OP_DIVK, [OP_LT] = &&L_OP_LT,
+        [OP_LE] = &&L_OP_LE, [OP_GT] = &&L_OP_GT, [OP_GE] = &&L_OP_GE,
+        [OP_EQ] = &&L_OP_EQ, [OP_NE] = &&L_OP_NE, [OP_JMP] = &&L_OP_JMP,
+        [OP_JZ] = &&L_OP_JZ, [OP_JNZ] = &&L_OP_JNZ, [OP_JLT] = &&L_OP_JLT,
+        [OP_JLE] = &&L_OP_JLE, [OP_JGT] = &&L_OP_JGT, [OP_JGE] = &&L_OP_JGE,
+        [OP_JEQ] = &&L_OP_JEQ, [OP_JNE] = &&L_OP_JNE, [OP_JLTK] = &&L_OP_JLTK,
+        [OP_JLEK] = &&L_OP_JLEK, [OP_JGTK] = &&L_OP_JGTK, [OP_JGEK] = &&L_OP_JGEK,
+        [OP_JEQK] = &&L_OP_JEQK, [OP_JNEK] = &&L_OP_JNEK, [OP_GETL] = &&L_OP_GETL,
+        [OP_SETL] = &&L_OP_SETL, [OP_GETGA] = &&L_OP_GETGA, [OP_SETGA] = &&L_OP_SETGA,
+        [OP_GETP] = &&L_OP_GETP, [OP_SETP] = &&L_OP_SETP, [OP_CALL] = &&L_OP_CALL,
+        [OP_RET] = &&L_OP_RET, [OP_RET0] = &&L_OP_RET0, [OP_IN] = &&L_OP_IN,
+        [OP_OUT] = &&L_OP_OUT,
+    };
+#endif
+    const int *pc = bc->code;
+    int memSize = bc->globals + INTERP_STACK_WORDS;
+    int *mem = calloc(memSize, sizeof(int));
+    int *end = mem + memSize;
+    int *r = mem + bc->globals; /* registers of the running call */
+    /* main's frame is not counted, as in interp */
+    VmFrame *frames = malloc((INTERP_MAX_CALLS + 1) * sizeof(VmFrame));
+    int depth = 0, failed = TRUE, i, v;
+    const VmFunc *f;
+    if (mem == NULL || frames == NULL)
+    {
+        fprintf(stderr, "Out of memory error running program\n");
+        free(mem);
+        free(frames);
+        return 1;
+    }
+    NEXT;
+    SWITCH_BEGIN
+CASE(OP_HALT):
+    failed = FALSE;
+    goto done;
+CASE(OP_KONST):
+    r[pc[1]] = pc[2];
+    pc += 3;
+    NEXT;
+CASE(OP_MOVE):
+    r[pc[1]] = r[pc[2]];
+    pc += 3;
+    NEXT;
+CASE(OP_GETG):
+    r[pc[1]] = mem[pc[2]];
+    pc += 3;
+    NEXT;
+CASE(OP_SETG):
+    mem[pc[1]] = r[pc[2]];
+    pc += 3;
+    NEXT;
+CASE(OP_ADDR):
+    r[pc[1]] = (int)(r + pc[2] - mem);
+    pc += 3;
+    NEXT;
+CASE(OP_ADD):
+    r[pc[1]] = WRAP(r[pc[2]], +, r[pc[3]]);
+    pc += 4;
+    NEXT;
+CASE(OP_SUB):
+    r[pc[1]] = WRAP(r[pc[2]], -, r[pc[3]]);
+    pc += 4;
+    NEXT;
+CASE(OP_MUL):
+    r[pc[1]] = WRAP(r[pc[2]], *, r[pc[3]]);
+    pc += 4;
+    NEXT;
+CASE(OP_DIV):
+    v = r[pc[3]];
+    if (v == 0 || (v == -1 && r[pc[2]] == INT_MIN))
+    {
+        vmError(bc, pc, v == 0 ? "division by zero" : "division overflow");
+        goto done;
+    }
+    r[pc[1]] = r[pc[2]] / v;
+    pc += 4;
+    NEXT;
+CASE(OP_ADDK):
+    r[pc[1]] = WRAP(r[pc[2]], +, pc[3]);
+    pc += 4;
+    NEXT;
+CASE(OP_SUBK):
+    r[pc[1]] = WRAP(r[pc[2]], -, pc[3]);
+    pc += 4;
+    NEXT;
+CASE(OP_MULK):
+    r[pc[1]] = WRAP(r[pc[2]], *, pc[3]);
+    pc += 4;
+    NEXT;
+CASE(OP_DIVK):
+    r[pc[1]] = r[pc[2]] / pc[3];
+    pc += 4;
+    NEXT;
+CASE(OP_LT):
+    r[pc[1]] = r[pc[2]] < r[pc[3]];
+    pc += 4;
+    NEXT;
+CASE(OP_LE):
+    r[pc[1]] = r[pc[2]] <= r[pc[3]];
+    pc += 4;
+    NEXT;
+CASE(OP_GT):
+    r[pc[1]] = r[pc[2]] > r[pc[3]];
+    pc += 4;
+    NEXT;
+CASE(OP_GE):
+    r[pc[1]] = r[pc[2]] >= r[pc[3]];
+    pc += 4;
+    NEXT;
+CASE(OP_EQ):
+    r[pc[1]] = r[pc[2]] == r[pc[3]];
+    pc += 4;
+    NEXT;
+CASE(OP_NE):
+    r[pc[1]] = r[pc[2]] != r[pc[3]];
+    pc += 4;
+    NEXT;
+CASE(OP_JMP):
+    pc += pc[1];
+    NEXT;
+CASE(OP_JZ):
+    pc += r[pc[1]] == 0 ? pc[2] : 3;
+    NEXT;
+CASE(OP_JNZ):
+    pc += r[pc[1]] != 0 ? pc[2] : 3;
+    NEXT;
+CASE(OP_JLT):
+    pc += r[pc[1]] < r[pc[2]] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JLE):
+    pc += r[pc[1]] <= r[pc[2]] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JGT):
+    pc += r[pc[1]] > r[pc[2]] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JGE):
+    pc += r[pc[1]] >= r[pc[2]] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JEQ):
+    pc += r[pc[1]] == r[pc[2]] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JNE):
+    pc += r[pc[1]] != r[pc[2]] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JLTK):
+    pc += r[pc[1]] < pc[2] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JLEK):
+    pc += r[pc[1]] <= pc[2] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JGTK):
+    pc += r[pc[1]] > pc[2] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JGEK):
+    pc += r[pc[1]] >= pc[2] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JEQK):
+    pc += r[pc[1]] == pc[2] ? pc[3] : 4;
+    NEXT;
+CASE(OP_JNEK):
+    pc += r[pc[1]] != pc[2] ? pc[3] : 4;
+    NEXT;
+CASE(OP_GETL):
+    i = r[pc[3]];
+    if ((unsigned)i >= (unsigned)pc[4])
+        goto bounds;
+    r[pc[1]] = r[pc[2] + i];
+    pc += 5;
+    NEXT;
+CASE(OP_SETL):
+    i = r[pc[2]];
+    if ((unsigned)i >= (unsigned)pc[3])
+        goto bounds;
+    r[pc[1] + i] = r[pc[4]];
+    pc += 5;
+    NEXT;
+CASE(OP_GETGA):
+    i = r[pc[3]];
+    if ((unsigned)i >= (unsigned)pc[4])
+        goto bounds;
+    r[pc[1]] = mem[pc[2] + i];
+    pc += 5;
+    NEXT;
+CASE(OP_SETGA):
+    i = r[pc[2]];
+    if ((unsigned)i >= (unsigned)pc[3])
+        goto bounds;
+    mem[pc[1] + i] = r[pc[4]];
+    pc += 5;
+    NEXT;
+CASE(OP_GETP):
+    i = r[pc[3]];
+    if ((unsigned)i >= (unsigned)r[pc[2] + 1])
+        goto boundsParam;
+    r[pc[1]] = mem[r[pc[2]] + i];
+    pc += 4;
+    NEXT;
+CASE(OP_SETP):
+    i = r[pc[2]];
+    if ((unsigned)i >= (unsigned)r[pc[1] + 1])
+        goto boundsParam;
+    mem[r[pc[1]] + i] = r[pc[3]];
+    pc += 4;
+    NEXT;
+CASE(OP_CALL):
+    if (pc[2] < 0)
+    {
+        fprintf(stderr, "Runtime error: no main function\n");
+        goto done;
+    }
+    f = &bc->funcs[pc[2]];
+    if (depth == INTERP_MAX_CALLS + 1)
+    {
+        vmError(bc, pc, "calls nested more than %d deep", INTERP_MAX_CALLS);
+        goto done;
+    }
+    if (f->regs > end - (r + pc[3]))
+    {
+        vmError(bc, pc, "out of stack memory");
+        goto done;
+    }
+    frames[depth].ret = pc + 4;
+    frames[depth].regs = r;
+    frames[depth++].dst = pc[1];
+    r += pc[3];
+    memset(r + f->params, 0, (f->frame - f->params) * sizeof(int));
+    pc = bc->code + f->entry;
+    NEXT;
+CASE(OP_RET):
+    v = r[pc[1]];
+    goto ret;
+CASE(OP_RET0):
+    v = 0;
+ret:
+    depth--;
+    r = frames[depth].regs;
+    r[frames[depth].dst] = v;
+    pc = frames[depth].ret;
+    NEXT;
+CASE(OP_IN):
+    if (fscanf(in, "%d", &v) != 1)
+    {
+        vmError(bc, pc, "no int left to input");
+        goto done;
+    }
+    r[pc[1]] = v;
+    pc += 2;
+    NEXT;
+CASE(OP_OUT):
+    fprintf(out, "%d\n", r[pc[1]]);
+    pc += 2;
+    NEXT;
+    SWITCH_END
+
+bounds:
+    vmError(bc, pc, "index %d out of bounds of %s[%d]", i, declName(bc->where[pc - bc->code]->decl),
+            *pc == OP_SETL || *pc == OP_SETGA ? pc[3] : pc[4]);
+    goto done;
+boundsParam:
+    vmError(bc, pc, "index %d out of bounds of %s[%d]", i, declName(bc->where[pc - bc->code]->decl),
+            *pc == OP_SETP ? r[pc[1] + 1] : r[pc[2] + 1]);
+done:
+    fflush(out);
+    free(mem);
+    free(frames);
+    return failed;
+}
@@ -0,0 +1,124 @@
+#ifndef _VM_H_
+#define _VM_H_
+
+/* The bytecode VM runs a C- program compiled from its
+ * analyzed syntax tree, faster than the interpreter of
+ * interp.h walks it, with the same results and runtime
+ * errors. The machine has registers instead of an
+ * operand stack: the registers of a call are the words
+ * of its frame, its variables first, in the slots
+ * analyze gave them, and then the temporaries of its
+ * expressions. An instruction names its registers, so
+ * i = i + 1 is the one instruction ADDK ri, ri, 1.
+ *
+ * Code is an array of ints: an opcode and then its
+ * operands, as many as opArgs gives, each a register
+ * (r), a constant (k), a global address (g), a jump
+ * offset from the start of the instruction (j) or a
+ * function (f). A call passes its arguments in the
+ * caller's registers from t on, which become the
+ * callee's params: the callee's frame starts there.
+ */
+
+typedef enum
+{
+    /* opcode       operands    what it does */
+    OP_HALT,     /*             stop */
+    OP_KONST,    /* r k         r = k */
+    OP_MOVE,     /* r r         r1 = r2 */
+    OP_GETG,     /* r g         r = mem[g] */
+    OP_SETG,     /* g r         mem[g] = r */
+    OP_ADDR,     /* r r         r1 = address of register r2 */
+    OP_ADD,      /* r r r       r1 = r2 + r3, and so on */
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_ADDK,     /* r r k       r1 = r2 + k, and so on */
+    OP_SUBK,
+    OP_MULK,
+    OP_DIVK,     /*             k is neither 0 nor -1 */
+    OP_LT,       /* r r r       r1 = r2 < r3, and so on */
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_JMP,      /* j           jump */
+    OP_JZ,       /* r j         jump if r == 0 */
+    OP_JNZ,      /* r j         jump if r != 0 */
+    OP_JLT,      /* r r j       jump if r1 < r2, and so on */
+    OP_JLE,
+    OP_JGT,
+    OP_JGE,
+    OP_JEQ,
+    OP_JNE,
+    OP_JLTK,     /* r k j       jump if r < k, and so on */
+    OP_JLEK,
+    OP_JGTK,
+    OP_JGEK,
+    OP_JEQK,
+    OP_JNEK,
+    OP_GETL,     /* r r r k     r1 = r2[r3], a local array of k words */
+    OP_SETL,     /* r r k r     r1[r2] = r3, likewise */
+    OP_GETGA,    /* r g r k     r1 = mem[g + r2], a global array of k words */
+    OP_SETGA,    /* g r k r     mem[g + r1] = r2, likewise */
+    OP_GETP,     /* r r r       r1 = r2[r3], an array param: r2 holds its
+                                address and the next register its length */
+    OP_SETP,     /* r r r       r1[r2] = r3, likewise */
+    OP_CALL,     /* r f r       r1 = f(the registers from r2 on) */
+    OP_RET,      /* r           return r */
+    OP_RET0,     /*             return 0 */
+    OP_IN,       /* r           r = input() */
+    OP_OUT,      /* r           output(r) */
+    OPCODES
+} OpCode;
+
+/* a compiled function */
+typedef struct
+{
+    const char *name;
+    int entry;  /* offset of its first instruction */
+    int params; /* registers its params take */
+    int frame;  /* registers of its params and locals */
+    int regs;   /* registers in all, with the temporaries */
+} VmFunc;
+
+typedef struct
+{
+    int *code;
+    const TreeNode **where; /* node each instruction came from, for errors */
+    int count, cap;         /* ints of code */
+    VmFunc *funcs;
+    int funcCount, funcCap;
+    int globals; /* words of global memory */
+} Bytecode;
+
+/* the number of operands each opcode takes, and their
+   kinds as letters, as in the table above */
+extern const int opArgs[OPCODES];
+extern const char *const opOperands[OPCODES];
+extern const char *const opName[OPCODES];
+
+/* Function compileProgram compiles an analyzed syntax
+ * tree without errors into bc, whose code starts with
+ * a call of main; it returns 0, or -1 if memory is
+ * exhausted
+ */
+int compileProgram(TreeNode *, Bytecode *bc);
+
+/* Procedure freeBytecode releases compiled code */
+void freeBytecode(Bytecode *);
+
+/* Procedure disassemble lists the code of each
+ * function to f, one instruction a line
+ */
+void disassemble(const Bytecode *, FILE *f);
+
+/* Function runBytecode runs compiled code as
+ * runProgram runs the tree (see interp.h), with the
+ * same memory, input and output and runtime errors;
+ * 0 when main returns, 1 after a runtime error
+ */
+int runBytecode(const Bytecode *, FILE *in, FILE *out);
+
+#endif
@@ -0,0 +1,103 @@
+#include "globals.h"
+#include "walk.h"
+
+/* a stack frame holds a node whose subtrees are being
+   walked and the child slot to enter next */
+typedef struct
+{
+    TreeNode *node;
+    TreeNode *prev;
+    int next;
+} WalkFrame;
+
+/* frames kept on the C stack before moving to the heap */
+#define LOCAL_FRAMES 256
+
+/* posAt fills in the position of the node in the
+   frame at depth */
+static void posAt(WalkPos *pos, const WalkFrame *frames, int depth)
+{
+    pos->parent = depth > 0 ? frames[depth - 1].node : NULL;
+    pos->slot = depth > 0 ? frames[depth - 1].next - 1 : -1;
+    pos->prev = frames[depth].prev;
+    pos->depth = depth;
+}
+
+/* Function walkTree visits t, its siblings and all of
+ * their descendants in depth-first order, calling pre
+ * on a node before its children and post after them
+ */
+int walkTree(TreeNode *t, TreeVisit pre, TreeVisit post, void *arg)
+{
+    WalkFrame local[LOCAL_FRAMES], *frames = local, *f;
+    WalkPos pos;
+    TreeNode *prev = NULL;
+    int cap = LOCAL_FRAMES, top = 0, result = 0, r;
+    while (t != NULL && result == 0)
+    {
+        /* enter t at depth top */
+        if (top == cap)
+        {
+            WalkFrame *grown = malloc(2 * cap * sizeof(WalkFrame));
+            if (grown == NULL)
+            {
+                result = -1;
+                break;
+            }
+            memcpy(grown, frames, cap * sizeof(WalkFrame));
+            if (frames != local)
+                free(frames);
+            frames = grown;
+            cap *= 2;
+        }
+        f = &frames[top];
+        f->node = t;
+        f->prev = prev;
+        f->next = 0;
+        r = WALK_CONTINUE;
+        if (pre != NULL)
+        {
+            posAt(&pos, frames, top);
+            r = pre(t, &pos, arg);
+        }
+        if (r == WALK_STOP)
+            result = WALK_STOP;
+        else if (r == WALK_SKIP)
+            f->next = MAXCHILDREN;
+
+        /* the next node to enter is the first child left
+           in the top frame; a frame with none left is
+           finished and gives way to its node's sibling,
+           or is popped at the end of its chain */
+        for (t = NULL; result == 0;)
+        {
+            f = &frames[top];
+            while (f->next < MAXCHILDREN && f->node->child[f->next] == NULL)
+                f->next++;
+            if (f->next < MAXCHILDREN)
+            {
+                t = f->node->child[f->next++];
+                prev = NULL;
+                top++;
+                break;
+            }
+            if (post != NULL)
+            {
+                posAt(&pos, frames, top);
+                if (post(f->node, &pos, arg) == WALK_STOP)
+                {
+                    result = WALK_STOP;
+                    break;
+                }
+            }
+            t = f->node->sibling;
+            prev = f->node;
+            if (t != NULL || top == 0)
+                break;
+            top--;
+        }
+    }
+    if (frames != local)
+        free(frames);
+    return result;
+}
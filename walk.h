@@ -0,0 +1,39 @@
+#ifndef _WALK_H_
+#define _WALK_H_
+
+/* walkTree visits every node of a syntax tree without
+ * recursion: the path from the top of the tree down to
+ * the node being visited is kept on an explicit stack,
+ * on the heap once it outgrows a small local array, so
+ * a tree nested a million levels deep walks in the same
+ * way as a shallow one. Siblings replace each other on
+ * the stack; it only grows with nesting depth.
+ */
+
+/* what a visit function returns */
+#define WALK_CONTINUE 0
+#define WALK_SKIP 1 /* from pre: do not visit the node's children */
+#define WALK_STOP 2 /* end the walk */
+
+/* where a visited node lies in the tree */
+typedef struct
+{
+    TreeNode *parent; /* NULL for the chain walkTree started at */
+    int slot;         /* parent's child slot the node's chain hangs from */
+    TreeNode *prev;   /* previous sibling; NULL for the first of its chain */
+    int depth;        /* 0 for the starting chain, 1 for its children... */
+} WalkPos;
+
+typedef int (*TreeVisit)(TreeNode *, const WalkPos *, void *);
+
+/* Function walkTree visits t, its siblings and all of
+ * their descendants in depth-first order, calling pre
+ * on a node before its children and post after them,
+ * children in slot order; either may be NULL. A node's
+ * sibling is read after post returns. Function walkTree
+ * returns WALK_STOP if a visit stopped the walk, -1 if
+ * memory for the stack is exhausted, otherwise 0
+ */
+int walkTree(TreeNode *t, TreeVisit pre, TreeVisit post, void *arg);
+
+#endif